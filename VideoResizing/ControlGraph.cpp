@@ -0,0 +1,52 @@
+#include "ControlGraph.h"
+
+ControlGraph::ControlGraph() {
+
+	pointNum = 0;
+
+}
+
+void ControlGraph::Build( const vector<ControlPoint> &controlPoints ) {
+
+	pointNum = controlPoints.size();
+
+	frameId.resize( pointNum );
+	anchorType.resize( pointNum );
+	originPos.resize( pointNum );
+	pos.resize( pointNum );
+	flow.resize( pointNum );
+	saliency.resize( pointNum );
+	boundPtr.assign( pointNum + 1, 0 );
+	temporalPtr.assign( pointNum + 1, 0 );
+
+	for ( int i = 0; i < pointNum; i++ ) {
+		const ControlPoint &point = controlPoints[i];
+		frameId[i] = point.frameId;
+		anchorType[i] = point.anchorType;
+		originPos[i] = point.originPos;
+		pos[i] = point.pos;
+		flow[i] = point.flow;
+		saliency[i] = point.saliency;
+		boundPtr[i + 1] = boundPtr[i] + point.boundNeighbors.size();
+		temporalPtr[i + 1] = temporalPtr[i] + point.temporalNeighbors.size();
+	}
+
+	boundIndex.resize( boundPtr[pointNum] );
+	temporalCoord.resize( temporalPtr[pointNum] );
+	for ( int i = 0; i < pointNum; i++ ) {
+		const ControlPoint &point = controlPoints[i];
+		copy( point.boundNeighbors.begin(), point.boundNeighbors.end(), boundIndex.begin() + boundPtr[i] );
+		copy( point.temporalNeighbors.begin(), point.temporalNeighbors.end(), temporalCoord.begin() + temporalPtr[i] );
+	}
+
+}
+
+Point2f ControlGraph::TemporalPos( int i ) const {
+
+	Point2f temporalPos( 0, 0 );
+	for ( int k = temporalPtr[i]; k < temporalPtr[i + 1]; k++ ) {
+		temporalPos += temporalCoord[k].first * pos[temporalCoord[k].second];
+	}
+	return temporalPos;
+
+}
\ No newline at end of file
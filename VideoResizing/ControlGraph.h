@@ -0,0 +1,41 @@
+#ifndef CONTROLGRAPH_H
+#define CONTROLGRAPH_H
+
+#include "common.h"
+#include "ControlPoint.h"
+
+/*
+Control points of a shot as structure of arrays, what the energy terms and the
+constraint builders stream over. Neighbors are compressed rows, the bound
+neighbors of point i are boundIndex[boundPtr[i]] up to boundPtr[i + 1] and its
+temporal barycentric coordinates sit in temporalCoord the same way. Built from
+the ControlPoint list once the graph is complete, and from then on the only copy
+of the control points.
+*/
+class ControlGraph {
+
+public:
+	int pointNum;
+
+	vector<int> frameId, anchorType;
+	vector<Point2f> originPos, pos, flow;
+	vector<double> saliency;
+
+	vector<int> boundPtr, boundIndex;
+	vector<int> temporalPtr;
+	vector<BaryCoord> temporalCoord;
+
+	ControlGraph();
+
+	void Build( const vector<ControlPoint> &controlPoints );
+
+	int BoundNum( int i ) const {
+		return boundPtr[i + 1] - boundPtr[i];
+	}
+
+	// Position of point i interpolated from its temporal neighbors.
+	Point2f TemporalPos( int i ) const;
+
+};
+
+#endif
\ No newline at end of file
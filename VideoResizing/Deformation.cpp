@@ -13,6 +13,9 @@ Deformation::Deformation( vector<KeyFrame> &_frames, const string &_videoName )
 
 	controlPointsNum = 0;
 	freeEleNum = 0;
+	useAdjacencyGraph = CONTROL_GRAPH_FROM_ADJACENCY;
+	controlGraphBuilt = false;
+	energyMatBuilt = false;
 	freeEleMap.clear();
 	controlPoints.clear();
 	centerControlPointIndex.clear();
@@ -26,7 +29,7 @@ Deformation::Deformation( vector<KeyFrame> &_frames, const string &_videoName )
 
 }
 
-void Deformation::DrawSubdiv( const Mat &_img, const Subdiv2D &subdiv ) {
+void Deformation::DrawSubdiv( const Mat &_img, const Subdiv2D &subdiv ) const {
 
 	Scalar delaunay_color( 255, 255, 255 );
 	Mat img = _img.clone();
@@ -72,40 +75,44 @@ void Deformation::DrawEdge( int frameId, int posType, Mat &_img ) {
 
 	for ( const auto &controlPointIndex : frameControlPointIndex[frameId] ) {
 
-		const ControlPoint &controlPoint = controlPoints[controlPointIndex];
+		if ( controlGraph.anchorType[controlPointIndex] != ControlPoint::ANCHOR_CENTER ) continue;
 
-		if ( controlPoint.anchorType != ControlPoint::ANCHOR_CENTER ) continue;
+		const Point2f &originPos = controlGraph.originPos[controlPointIndex];
+		const Point2f &pos = controlGraph.pos[controlPointIndex];
 
 		if ( posType == ORIGIN_POS || posType == ORIGIN_POS_WITH_FRAME ) {
-			circle( img, controlPoint.originPos, 3, centerColor, 2, CV_AA );
+			circle( img, originPos, 3, centerColor, 2, CV_AA );
 		} else {
-			circle( img, controlPoint.pos, 3, centerColor, 2, CV_AA );
+			circle( img, pos, 3, centerColor, 2, CV_AA );
 		}
 
-		for ( const auto &neighborIndex : controlPoint.boundNeighbors ) {
+		for ( int k = controlGraph.boundPtr[controlPointIndex]; k < controlGraph.boundPtr[controlPointIndex + 1]; k++ ) {
 
-			const ControlPoint &neighborPoint = controlPoints[neighborIndex];
+			int neighborIndex = controlGraph.boundIndex[k];
+			int neighborType = controlGraph.anchorType[neighborIndex];
+			const Point2f &neighborOriginPos = controlGraph.originPos[neighborIndex];
+			const Point2f &neighborPos = controlGraph.pos[neighborIndex];
 
-			if ( neighborPoint.anchorType == ControlPoint::ANCHOR_CENTER ) {
-				cout << controlPoint.originPos << " " << neighborPoint.originPos << endl;
+			if ( neighborType == ControlPoint::ANCHOR_CENTER ) {
+				cout << originPos << " " << neighborOriginPos << endl;
 			}
 
 			if ( posType == ORIGIN_POS || posType == ORIGIN_POS_WITH_FRAME ) {
 
-				line( img, controlPoint.originPos, neighborPoint.originPos, lineColor, 1, CV_AA );
-				if ( neighborPoint.anchorType == ControlPoint::ANCHOR_BOUND ) {
-					circle( img, neighborPoint.originPos, 3, boundColor, 2, CV_AA );
+				line( img, originPos, neighborOriginPos, lineColor, 1, CV_AA );
+				if ( neighborType == ControlPoint::ANCHOR_BOUND ) {
+					circle( img, neighborOriginPos, 3, boundColor, 2, CV_AA );
 				} else {
-					circle( img, neighborPoint.originPos, 3, staticColor, 2, CV_AA );
+					circle( img, neighborOriginPos, 3, staticColor, 2, CV_AA );
 				}
 				
 			} else {
 
-				line( img, controlPoint.pos, neighborPoint.pos, lineColor, 1, CV_AA );
-				if ( neighborPoint.anchorType == ControlPoint::ANCHOR_BOUND ) {
-					circle( img, neighborPoint.pos, 3, boundColor, 2, CV_AA );
+				line( img, pos, neighborPos, lineColor, 1, CV_AA );
+				if ( neighborType == ControlPoint::ANCHOR_BOUND ) {
+					circle( img, neighborPos, 3, boundColor, 2, CV_AA );
 				} else {
-					circle( img, neighborPoint.pos, 3, staticColor, 2, CV_AA );
+					circle( img, neighborPos, 3, staticColor, 2, CV_AA );
 				}
 				
 			}
@@ -125,9 +132,8 @@ void Deformation::DrawLocate( const Point2f &deformedPoint, const vector<BaryCoo
 	circle( img, deformedPoint, 5, Scalar( 255, 0, 0 ), 2, CV_AA );
 
 	for ( const auto &vertex : baryCoord ) {
-		ControlPoint controlPoint = controlPoints[vertex.second];
-		circle( img, controlPoint.originPos, 5, Scalar( 0, 0, 128 ), 2, CV_AA );
-		circle( img, controlPoint.pos, 5, Scalar( 128, 0, 0 ), 2, CV_AA );
+		circle( img, controlGraph.originPos[vertex.second], 5, Scalar( 0, 0, 128 ), 2, CV_AA );
+		circle( img, controlGraph.pos[vertex.second], 5, Scalar( 128, 0, 0 ), 2, CV_AA );
 	}
 
 	Point2f originPoint = CalcPointByBaryCoord( baryCoord, ORIGIN_POS );
@@ -138,301 +144,337 @@ void Deformation::DrawLocate( const Point2f &deformedPoint, const vector<BaryCoo
 
 }
 
-Point2f Deformation::GetBoundPoint( int index0, int index1 ) {
+Point2f Deformation::GetBoundPoint( const vector<ControlPoint> &points, int index0, int index1 ) const {
 
-	ControlPoint p0 = controlPoints[index0];
-	ControlPoint p1 = controlPoints[index1];
-
-	if ( p0.saliency < p1.saliency ) {
-		swap( p0, p1 );
+	if ( points[index0].saliency < points[index1].saliency ) {
+		swap( index0, index1 );
 	}
 
-	int superpixelIndex = p0.superpixelIndex;
-	int frameId = p0.frameId;
-	Point2f neighborPoint( -1, -1 );
-
-	if ( SignNumber( p0.originPos.x - p1.originPos.x ) == 0 ) {
-
-		int x = p0.originPos.x;
-		if ( p0.originPos.y < p1.originPos.y ) {
-			for ( int y = p0.originPos.y; y < p1.originPos.y; y++ ) {
-				if ( frames[frameId].pixelLabel.at<int>( y, x ) != superpixelIndex ) {
-					neighborPoint = Point( x, y );
-					break;
-				}
-			}
-		} else {
-			for ( int y = p0.originPos.y; y > p1.originPos.y; y-- ) {
-				if ( frames[frameId].pixelLabel.at<int>( y, x ) != superpixelIndex ) {
-					neighborPoint = Point( x, y );
-					break;
-				}
-			}
-		}
-
-	} else {
-
-		int dx = 1;
-		double k = (p1.originPos.y - p0.originPos.y) / abs( p0.originPos.x - p1.originPos.x );
-		if ( p0.originPos.x > p1.originPos.x ) dx = -1;
+	const ControlPoint &p0 = points[index0];
+	const ControlPoint &p1 = points[index1];
+	const KeyFrame &frame = frames[p0.frameId];
 
-		if ( dx > 0 ) {
+	// Adjacent superpixels, the boundary pixel pair nearest to the line between the centers was found
+	// while reducing the labels. Like the walk below, take the pixel just out of the superpixel of p0.
+	const LabelAdjacency *adjacency = frame.FindAdjacency( p0.superpixelIndex, p1.superpixelIndex );
+	if ( adjacency != NULL && adjacency->crossPoint0.x >= 0 ) {
+		return Point2f( adjacency->label0 == p0.superpixelIndex ? adjacency->crossPoint1 : adjacency->crossPoint0 );
+	}
 
-			for ( int x = p0.originPos.x; x < p1.originPos.x; x += dx ) {
+	// Otherwise the first pixel out of the superpixel of p0 on the way to p1.
+	const LabelMap &labelMap = frame.labelMap;
+	Point2f delta = p1.originPos - p0.originPos;
+	int stepNum = CeilToInt( max( abs( delta.x ), abs( delta.y ) ) );
+	for ( int t = 1; t < stepNum; t++ ) {
+		Point p( RoundToInt( p0.originPos.x + delta.x * t / stepNum ), RoundToInt( p0.originPos.y + delta.y * t / stepNum ) );
+		if ( labelMap.At( p ) != p0.superpixelIndex ) return p;
+	}
 
-				int y = RoundToInt( p0.originPos.y + k * abs( x - p0.originPos.x ) );
-				int tmpY = RoundToInt( p0.originPos.y + k * abs( x + dx - p0.originPos.x ) );
+	return 0.5 * (p0.originPos + p1.originPos);
 
-				if ( k > 0 ) {
-					while ( y <= tmpY ) {
-						if ( frames[frameId].pixelLabel.at<int>( y, x ) != superpixelIndex ) {
-							neighborPoint = Point( x, y );
-							break;
-						}
-						y++;
-					}
-					if ( neighborPoint.x != -1 ) break;
+}
 
-				} else {
-					
-					while ( y >= tmpY ) {
-						if ( frames[frameId].pixelLabel.at<int>( y, x ) != superpixelIndex ) {
-							neighborPoint = Point( x, y );
-							break;
-						}
-						y--;
-					}
-					if ( neighborPoint.x != -1 ) break;
+// Undirected edge between two control points packed as (min, max).
+static inline uint64 EdgeKey( int index0, int index1 ) {
+	return ((uint64)min( index0, index1 ) << 32) | (unsigned)max( index0, index1 );
+}
 
-				}
+void MarkFirstEdges( const vector<Vec4f> &edgeList, const Mat &pointsMap, vector<bool> &edgeFirst ) {
+
+	// Center pairs of the inside edges, a pair seen before is skipped like in edge list order.
+	Size size = pointsMap.size();
+	vector< pair<uint64, int> > edgeKeys;
+	edgeKeys.reserve( edgeList.size() );
+	for ( size_t k = 0; k < edgeList.size(); k++ ) {
+		const Vec4f &e = edgeList[k];
+		Point2f p0( e.val[0], e.val[1] );
+		Point2f p1( e.val[2], e.val[3] );
+		if ( CheckOutside( p0, size ) || CheckOutside( p1, size ) ) continue;
+		int index0 = pointsMap.at<int>( p0 );
+		int index1 = pointsMap.at<int>( p1 );
+		edgeKeys.push_back( make_pair( EdgeKey( index0, index1 ), (int)k ) );
+	}
+	sort( edgeKeys.begin(), edgeKeys.end() );
+	edgeFirst.assign( edgeList.size(), false );
+	for ( size_t k = 0; k < edgeKeys.size(); k++ ) {
+		if ( k == 0 || edgeKeys[k].first != edgeKeys[k - 1].first ) edgeFirst[edgeKeys[k].second] = true;
+	}
 
-			}
+}
 
-		} else {
+// Coordinates of a control point left to the solver.
+static inline int FreeEleNum( int anchorType ) {
+	switch ( anchorType ) {
+		case ControlPoint::ANCHOR_CENTER:
+		case ControlPoint::ANCHOR_BOUND:
+			return 2;
+		case ControlPoint::ANCHOR_STATIC_BOTTOM:
+		case ControlPoint::ANCHOR_STATIC_TOP:
+		case ControlPoint::ANCHOR_STATIC_LEFT:
+		case ControlPoint::ANCHOR_STATIC_RIGHT:
+			return 1;
+		default:
+			return 0;
+	}
+}
 
-			for ( int x = p0.originPos.x; x > p1.originPos.x; x += dx ) {
+void Deformation::AddBoundControlPoint( FrameControlGraph &graph, int frameId, int index0, int index1, const Point2f &neighborPoint ) const {
 
-				int y = RoundToInt( p0.originPos.y + k * abs( x - p0.originPos.x ) );
-				int tmpY = RoundToInt( p0.originPos.y + k * abs( x + dx - p0.originPos.x ) );
-				
-				if ( k > 0 ) {
-					while ( y <= tmpY ) {
-						if ( frames[frameId].pixelLabel.at<int>( y, x ) != superpixelIndex ) {
-							neighborPoint = Point( x, y );
-							break;
-						}
-						y++;
-					}
-					if ( neighborPoint.x != -1 ) break;
+	vector<ControlPoint> &points = graph.points;
+	int index = points.size();
 
-				} else {
-					while ( y >= tmpY ) {
-						if ( frames[frameId].pixelLabel.at<int>( y, x ) != superpixelIndex ) {
-							neighborPoint = Point( x, y );
-							break;
-						}
-						y--;
-					}
-					if ( neighborPoint.x != -1 ) break;
+	points.push_back( ControlPoint( frameId, neighborPoint, ControlPoint::ANCHOR_BOUND, -1, -1 ) );
+	graph.pointsMap.at<int>( neighborPoint ) = index;
 
-				}
+	points[index0].AddBoundNeighbor( index );
+	points[index1].AddBoundNeighbor( index );
+	points[index].AddBoundNeighbor( index0 );
+	points[index].AddBoundNeighbor( index1 );
 
-			}
+	points[index0].AddSuperpixelNeighbor( index1 );
+	points[index1].AddSuperpixelNeighbor( index0 );
 
-		}
+}
 
-	}
+void Deformation::AddStaticControlPoint( FrameControlGraph &graph, int frameId, const Point2f &point, int anchorType, int superpixelIndex, int controlPointIndex ) const {
 
-	if ( neighborPoint == Point2f( -1, -1 ) ) {
-		neighborPoint = 0.5 * (p0.originPos + p1.originPos);
-	}
+	vector<ControlPoint> &points = graph.points;
+	int index = points.size();
 
-	return neighborPoint;
+	points.push_back( ControlPoint( frameId, point, anchorType, superpixelIndex, -1 ) );
+	graph.pointsMap.at<int>( point ) = index;
+	points[controlPointIndex].AddBoundNeighbor( index );
+	points[index].AddBoundNeighbor( controlPointIndex );
 
 }
 
-void Deformation::BuildControlPoints() {
-
-	printf( "\tBuild key frames control points. " );
+void Deformation::BuildFrameControlGraph( int i, FrameControlGraph &graph ) const {
 
 // #define DEBUG_DELAUNAY_DIVIDE
 
-	for ( int i = 0; i < frameNum; i++ ) {
+	// Indices are local to the frame, the centers come first so center j is point j.
+	vector<ControlPoint> &points = graph.points;
 
-		Rect rect( 0, 0, frameSize.width, frameSize.height );
-		Subdiv2D subdiv( rect );
-		double superpixelMaxDist = 1.8 * sqrt( frameSize.width * frameSize.height / (double)frames[i].superpixelNum );
-		controlPointsMap.push_back( Mat( frameSize, CV_32SC1, Scalar( -1 ) ) );
+	// Without an adjacency graph fall back to Delaunay edges between the centers.
+	bool useAdjacency = useAdjacencyGraph && !frames[i].GetAdjacency().empty();
 
-		// Add superpixel center points.
-		frameControlPointIndex[i] = vector<int>( frames[i].superpixelNum );
-		for ( int j = 0; j < frames[i].superpixelNum; j++ ) {
-			double saliency = frames[i].superpixelSaliency[j];
-			controlPoints.push_back( ControlPoint( i, frames[i].superpixelCenter[j], ControlPoint::ANCHOR_CENTER, j, saliency ) );
-			controlPointsMap[i].at<int>( frames[i].superpixelCenter[j] ) = controlPointsNum;
-			frameControlPointIndex[i][j] = controlPointsNum;
-			centerControlPointIndex.push_back( controlPointsNum );
+	Rect rect( 0, 0, frameSize.width, frameSize.height );
+	Subdiv2D subdiv( rect );
+	double superpixelMaxDist = 1.8 * sqrt( frameSize.width * frameSize.height / (double)frames[i].superpixelNum );
+	graph.pointsMap = Mat( frameSize, CV_32SC1, Scalar( -1 ) );
+
+	// Add superpixel center points.
+	for ( int j = 0; j < frames[i].superpixelNum; j++ ) {
+		double saliency = frames[i].superpixelSaliency[j];
+		points.push_back( ControlPoint( i, frames[i].superpixelCenter[j], ControlPoint::ANCHOR_CENTER, j, saliency ) );
+		graph.pointsMap.at<int>( frames[i].superpixelCenter[j] ) = j;
 
-			subdiv.insert( frames[i].superpixelCenter[j] );
-			controlPointsNum++;
+		if ( !useAdjacency ) subdiv.insert( frames[i].superpixelCenter[j] );
 
 #ifdef DEBUG_DELAUNAY_DIVIDE
-			DrawSubdiv( frames[i].img, subdiv );
+		DrawSubdiv( frames[i].img, subdiv );
 #endif
 
+	}
+
+	// Add superpixel bound points, dropping long links between two border superpixels like the Delaunay path does.
+	if ( useAdjacency ) {
+		for ( const auto &adjacency : frames[i].GetAdjacency() ) {
+			if ( frames[i].superpixelBoundLabel[adjacency.label0] != KeyFrame::BOUND_NONE &&
+				 frames[i].superpixelBoundLabel[adjacency.label1] != KeyFrame::BOUND_NONE ) {
+				double superpixelDist = NormL2( frames[i].superpixelCenter[adjacency.label0] - frames[i].superpixelCenter[adjacency.label1] );
+				if ( superpixelDist > superpixelMaxDist ) continue;
+			}
+			AddBoundControlPoint( graph, i, adjacency.label0, adjacency.label1, adjacency.midPoint );
 		}
+	}
 
-		// Add superpixel bound points.
-		vector<Vec4f> edgeList;
-		subdiv.getEdgeList( edgeList );
-		map< string, int> edgeExist;
+	vector<Vec4f> edgeList;
+	if ( !useAdjacency ) subdiv.getEdgeList( edgeList );
 
-		for ( const auto &e : edgeList ) {
+	vector<bool> edgeFirst;
+	MarkFirstEdges( edgeList, graph.pointsMap, edgeFirst );
 
-			Point2f p0( e.val[0], e.val[1] );
-			Point2f p1( e.val[2], e.val[3] );
+	for ( size_t k = 0; k < edgeList.size(); k++ ) {
 
-			if ( CheckOutside( p0, frameSize ) || CheckOutside( p1, frameSize ) ) {
-				continue;
-			}
+		if ( !edgeFirst[k] ) continue;
 
-			int index0 = controlPointsMap[i].at<int>( p0 );
-			int index1 = controlPointsMap[i].at<int>( p1 );
+		const Vec4f &e = edgeList[k];
+		Point2f p0( e.val[0], e.val[1] );
+		Point2f p1( e.val[2], e.val[3] );
 
-			string edgeHash0 = to_string( index0 ) + " " + to_string( index1 );
-			string edgeHash1 = to_string( index1 ) + " " + to_string( index0 );
-			if ( edgeExist.count( edgeHash0 ) > 0 ) continue;
-			if ( edgeExist.count( edgeHash1 ) > 0 ) continue;
-			edgeExist[edgeHash0] = 1;
-			edgeExist[edgeHash1] = 1;
+		int index0 = graph.pointsMap.at<int>( p0 );
+		int index1 = graph.pointsMap.at<int>( p1 );
 
-			if ( frames[i].superpixelBoundLabel[controlPoints[index0].superpixelIndex] != KeyFrame::BOUND_NONE &&
-				 frames[i].superpixelBoundLabel[controlPoints[index1].superpixelIndex] != KeyFrame::BOUND_NONE ) {
-				double superpixelDist = NormL2( p0 - p1 );
-				if ( superpixelDist > superpixelMaxDist ) continue;
-			}
+		if ( frames[i].superpixelBoundLabel[points[index0].superpixelIndex] != KeyFrame::BOUND_NONE &&
+			 frames[i].superpixelBoundLabel[points[index1].superpixelIndex] != KeyFrame::BOUND_NONE ) {
+			double superpixelDist = NormL2( p0 - p1 );
+			if ( superpixelDist > superpixelMaxDist ) continue;
+		}
 
-			Point2f neighborPoint = GetBoundPoint( index0, index1 );
-			controlPoints.push_back( ControlPoint( i, neighborPoint, ControlPoint::ANCHOR_BOUND, -1, -1 ) );
-			controlPointsMap[i].at<int>( neighborPoint ) = controlPointsNum;
+		Point2f neighborPoint = GetBoundPoint( points, index0, index1 );
+		AddBoundControlPoint( graph, i, index0, index1, neighborPoint );
 
-			controlPoints[index0].AddBoundNeighbor( controlPointsNum );
-			controlPoints[index1].AddBoundNeighbor( controlPointsNum );
-			controlPoints[controlPointsNum].AddBoundNeighbor( index0 );
-			controlPoints[controlPointsNum].AddBoundNeighbor( index1 );
+	}
 
-			controlPoints[index0].AddSuperpixelNeighbor( index1 );
-			controlPoints[index1].AddSuperpixelNeighbor( index0 );
+	// Add anchor points.
+	for ( const auto &point : staticPoints ) {
+		int label = frames[i].labelMap.At( point );
+		AddStaticControlPoint( graph, i, point, ControlPoint::ANCHOR_STATIC, label, label );
+	}
 
-			controlPointsNum++;
+	// Add image bound points.
+	for ( int j = 0; j < frames[i].superpixelNum; j++ ) {
 
-		}
+		Point2f center = frames[i].superpixelCenter[j];
+
+		switch ( frames[i].superpixelBoundLabel[j] ) {
 
-		// Add anchor points.
-		for ( const auto &point : staticPoints ) {
+			case KeyFrame::BOUND_LEFT:
+				AddStaticControlPoint( graph, i, Point( 0, center.y ), ControlPoint::ANCHOR_STATIC_LEFT, j, j );
+				break;
 
-			int label = frames[i].pixelLabel.at<int>( point );
-			int controlPointIndex = frameControlPointIndex[i][label];
+			case KeyFrame::BOUND_TOP:
+				AddStaticControlPoint( graph, i, Point( center.x, 0 ), ControlPoint::ANCHOR_STATIC_TOP, j, j );
+				break;
 
-			controlPoints.push_back( ControlPoint( i, point, ControlPoint::ANCHOR_STATIC, label, -1 ) );
-			controlPointsMap[i].at<int>( point ) = controlPointsNum;
-			controlPoints[controlPointIndex].AddBoundNeighbor( controlPointsNum );
-			controlPoints[controlPointsNum].AddBoundNeighbor( controlPointIndex );
+			case KeyFrame::BOUND_RIGHT:
+				AddStaticControlPoint( graph, i, Point( frameSize.width - 1, center.y ), ControlPoint::ANCHOR_STATIC_RIGHT, j, j );
+				break;
 
-			controlPointsNum++;
+			case KeyFrame::BOUND_BOTTOM:
+				AddStaticControlPoint( graph, i, Point( center.x, frameSize.height - 1 ), ControlPoint::ANCHOR_STATIC_BOTTOM, j, j );
+				break;
 
+			case KeyFrame::BOUND_NONE:
+				break;
+			default:
+				break;
 		}
+	}
 
-		// Add image bound points.
-		for ( int j = 0; j < frames[i].superpixelNum; j++ ) {
+	graph.freeEleNum = 0;
+	for ( const auto &point : points ) {
+		graph.freeEleNum += FreeEleNum( point.anchorType );
+	}
 
-			Point2f center = frames[i].superpixelCenter[j];
-			Point pointBound;
-			int controlPointIndex = frameControlPointIndex[i][j];
+}
 
-			switch ( frames[i].superpixelBoundLabel[j] ) {
+/*
+Builds the control graph of every key frame with frame local indices.
+*/
+class ControlGraphBuildBody : public ParallelLoopBody {
 
-				case KeyFrame::BOUND_LEFT:
-					pointBound = Point( 0, center.y );
-					controlPoints.push_back( ControlPoint( i, pointBound, ControlPoint::ANCHOR_STATIC_LEFT, j, -1 ) );
-					controlPointsMap[i].at<int>( pointBound ) = controlPointsNum;
-					controlPoints[controlPointIndex].AddBoundNeighbor( controlPointsNum );
-					controlPoints[controlPointsNum].AddBoundNeighbor( controlPointIndex );
-					controlPointsNum++;
-					
-					break;
+private:
+	const Deformation &deformation;
+	vector<FrameControlGraph> &graphs;
 
-				case KeyFrame::BOUND_TOP:
-					pointBound = Point( center.x, 0 );
-					controlPoints.push_back( ControlPoint( i, pointBound, ControlPoint::ANCHOR_STATIC_TOP, j, -1 ) );
-					controlPointsMap[i].at<int>( pointBound ) = controlPointsNum;
-					controlPoints[controlPointIndex].AddBoundNeighbor( controlPointsNum );
-					controlPoints[controlPointsNum].AddBoundNeighbor( controlPointIndex );
-					controlPointsNum++;
-					
-					break;
+public:
+	ControlGraphBuildBody( const Deformation &_deformation, vector<FrameControlGraph> &_graphs ) :
+		deformation( _deformation ), graphs( _graphs ) {}
 
-				case KeyFrame::BOUND_RIGHT:
-					pointBound = Point( frameSize.width - 1, center.y );
-					controlPoints.push_back( ControlPoint( i, pointBound, ControlPoint::ANCHOR_STATIC_RIGHT, j, -1 ) );
-					controlPointsMap[i].at<int>( pointBound ) = controlPointsNum;
-					controlPoints[controlPointIndex].AddBoundNeighbor( controlPointsNum );
-					controlPoints[controlPointsNum].AddBoundNeighbor( controlPointIndex );
-					controlPointsNum++;
-					
-					break;
+	void operator()( const Range &range ) const {
+		for ( int i = range.start; i < range.end; i++ ) {
+			deformation.BuildFrameControlGraph( i, graphs[i] );
+		}
+	}
 
-				case KeyFrame::BOUND_BOTTOM:
-					pointBound = Point( center.x, frameSize.height - 1 );
-					controlPoints.push_back( ControlPoint( i, pointBound, ControlPoint::ANCHOR_STATIC_BOTTOM, j, -1 ) );
-					controlPointsMap[i].at<int>( pointBound ) = controlPointsNum;
-					controlPoints[controlPointIndex].AddBoundNeighbor( controlPointsNum );
-					controlPoints[controlPointsNum].AddBoundNeighbor( controlPointIndex );
-					controlPointsNum++;
-					
-					break;
+};
+
+/*
+Moves the frame graphs into the global arrays, every frame shifted by the prefix
+sums of the point and free element counts of the frames before it.
+*/
+class ControlGraphStitchBody : public ParallelLoopBody {
+
+private:
+	Deformation &deformation;
+	vector<FrameControlGraph> &graphs;
+	const vector<int> &pointOffset;
+	const vector<int> &freeEleOffset;
+
+public:
+	ControlGraphStitchBody( Deformation &_deformation, vector<FrameControlGraph> &_graphs, const vector<int> &_pointOffset, const vector<int> &_freeEleOffset ) :
+		deformation( _deformation ), graphs( _graphs ), pointOffset( _pointOffset ), freeEleOffset( _freeEleOffset ) {}
+
+	void operator()( const Range &range ) const {
+		for ( int i = range.start; i < range.end; i++ ) {
+
+			vector<ControlPoint> &points = graphs[i].points;
+			int offset = pointOffset[i];
+			int freeEleIndex = freeEleOffset[i];
+			Mat &pointsMap = graphs[i].pointsMap;
+
+			// Later points overwrite earlier ones in the map, as they did when built.
+			pointsMap.setTo( Scalar( -1 ) );
+			for ( size_t k = 0; k < points.size(); k++ ) {
+
+				ControlPoint &point = deformation.controlPoints[offset + k];
+				point = move( points[k] );
+				for ( auto &neighbor : point.boundNeighbors ) neighbor += offset;
+				for ( auto &neighbor : point.superpixelNeighbors ) neighbor += offset;
+				pointsMap.at<int>( point.originPos ) = offset + k;
+
+				int index = offset + k;
+				switch ( point.anchorType ) {
+					case ControlPoint::ANCHOR_CENTER:
+					case ControlPoint::ANCHOR_BOUND:
+						deformation.freeEleMap[2 * index] = freeEleIndex++;
+						deformation.freeEleMap[2 * index + 1] = freeEleIndex++;
+						break;
+					case ControlPoint::ANCHOR_STATIC_BOTTOM:
+					case ControlPoint::ANCHOR_STATIC_TOP:
+						deformation.freeEleMap[2 * index] = freeEleIndex++;
+						break;
+					case ControlPoint::ANCHOR_STATIC_LEFT:
+					case ControlPoint::ANCHOR_STATIC_RIGHT:
+						deformation.freeEleMap[2 * index + 1] = freeEleIndex++;
+						break;
+					default:
+						break;
+				}
 
-				case KeyFrame::BOUND_NONE:
-					break;
-				default:
-					break;
 			}
+
+			deformation.controlPointsMap[i] = pointsMap;
+			vector<int> &frameIndex = deformation.frameControlPointIndex[i];
+			frameIndex.resize( deformation.frames[i].superpixelNum );
+			for ( size_t j = 0; j < frameIndex.size(); j++ ) {
+				frameIndex[j] = offset + j;
+			}
+
+			points.clear();
+
 		}
+	}
 
-#ifdef DEBUG_DELAUNAY_DIVIDE
-		Mat img;
-		DrawEdge( i, ORIGIN_POS_WITH_FRAME, img );
-		imshow( "Edge", img );
-		waitKey( 0 );
-#endif
+};
 
+void Deformation::BuildControlPoints() {
+
+	printf( "\tBuild key frames control points. " );
+
+	vector<FrameControlGraph> graphs( frameNum );
+	parallel_for_( Range( 0, frameNum ), ControlGraphBuildBody( *this, graphs ) );
+
+	vector<int> pointOffset( frameNum + 1, 0 ), freeEleOffset( frameNum + 1, 0 );
+	for ( int i = 0; i < frameNum; i++ ) {
+		pointOffset[i + 1] = pointOffset[i] + graphs[i].points.size();
+		freeEleOffset[i + 1] = freeEleOffset[i] + graphs[i].freeEleNum;
 	}
 
-	freeEleNum = 0;
+	controlPointsNum = pointOffset[frameNum];
+	freeEleNum = freeEleOffset[frameNum];
+	controlPoints.resize( controlPointsNum );
 	freeEleMap = vector<int>( 2 * controlPointsNum, -1 );
+	controlPointsMap.resize( frameNum );
+	parallel_for_( Range( 0, frameNum ), ControlGraphStitchBody( *this, graphs, pointOffset, freeEleOffset ) );
 
-	for ( int i = 0; i < controlPointsNum; i++ ) {
-		const ControlPoint &p = controlPoints[i];
-		switch ( p.anchorType ) {
-			case ControlPoint::ANCHOR_CENTER:
-			case ControlPoint::ANCHOR_BOUND:
-				freeEleMap[2 * i] = freeEleNum++;
-				freeEleMap[2 * i + 1] = freeEleNum++;
-				break;
-			case ControlPoint::ANCHOR_STATIC_BOTTOM:
-			case ControlPoint::ANCHOR_STATIC_TOP:
-				freeEleMap[2 * i] = freeEleNum++;
-				break;
-			case ControlPoint::ANCHOR_STATIC_LEFT:
-			case ControlPoint::ANCHOR_STATIC_RIGHT:
-				freeEleMap[2 * i + 1] = freeEleNum++;
-				break;
-			default:
-				break;
-		}
+	centerControlPointIndex.clear();
+	for ( int i = 0; i < frameNum; i++ ) {
+		centerControlPointIndex.insert( centerControlPointIndex.end(), frameControlPointIndex[i].begin(), frameControlPointIndex[i].end() );
 	}
 
-
 	printf( "Control point num: %d.\n", controlPointsNum );
 
 }
@@ -748,14 +790,17 @@ int Deformation::LocatePoint( Subdiv2D &subdiv, const Mat &cpMap, const Point2f
 	}
 
 #ifdef DEBUG_LOCATE_POINT
-	Point2f tmpP0 = CalcPointByBaryCoord( baryCoord, ORIGIN_POS );
-	Point2f tmpP1 = CalcPointByBaryCoord( baryCoord, DEFORMED_POS );
-	cout << p << " " << tmpP0 << " " << tmpP1 << endl;
-	for ( const auto &coord : baryCoord ) {
-		cout << coord.first << " " << controlPoints[coord.second].originPos << " " << controlPoints[coord.second].pos << endl;
+	// Positions live in the control graph, which does not exist yet while the temporal neighbors are located.
+	if ( controlGraphBuilt ) {
+		Point2f tmpP0 = CalcPointByBaryCoord( baryCoord, ORIGIN_POS );
+		Point2f tmpP1 = CalcPointByBaryCoord( baryCoord, DEFORMED_POS );
+		cout << p << " " << tmpP0 << " " << tmpP1 << endl;
+		for ( const auto &coord : baryCoord ) {
+			cout << coord.first << " " << controlGraph.originPos[coord.second] << " " << controlGraph.pos[coord.second] << endl;
+		}
+		cout << endl;
+		// DrawLocate( p, baryCoord );
 	}
-	cout << endl;
-	// DrawLocate( p, baryCoord );
 #endif
 
 	return locateStatus;
@@ -776,6 +821,22 @@ void Deformation::AddTemporalNeighbors() {
 
 	for ( int frameId = 0; frameId < frameNum - 1; frameId++ ) {
 
+		// Superpixels sharing a track id are the same region, their centers match without point location.
+		// Only when the labels of the next frame carry over from this one, cold started ids are unrelated.
+		map<int, int> trackCenterIndex;
+		const KeyFrame &nextFrame = frames[frameId + 1];
+		if ( nextFrame.superpixelTracked && !frames[frameId].superpixelTrackId.empty() && !nextFrame.superpixelTrackId.empty() ) {
+			for ( int j = 0; j < nextFrame.superpixelNum; j++ ) {
+				int trackId = nextFrame.superpixelTrackId[j];
+				if ( trackId < 0 ) continue;
+				if ( trackCenterIndex.count( trackId ) ) {
+					trackCenterIndex[trackId] = -1;
+				} else {
+					trackCenterIndex[trackId] = frameControlPointIndex[frameId + 1][j];
+				}
+			}
+		}
+
 		Subdiv2D subdiv( rect );
 
 		for ( ; nextFramePointIndex < controlPointsNum; nextFramePointIndex++ ) {
@@ -794,10 +855,22 @@ void Deformation::AddTemporalNeighbors() {
 
 			Point2f flow = frames[controlPoint.frameId].forwardFlowMap.at<Point2f>( Point( controlPoint.originPos ) );
 			Point2f nextFramePos = controlPoint.originPos + flow;
-			controlPoint.flow = Point2f( flow.x * deformedScaleX, flow.y * deformedScaleY );
+			controlPoint.flow = flow;
 
 			if ( CheckOutside( nextFramePos, frameSize ) ) continue;
 
+			if ( controlPoint.anchorType == ControlPoint::ANCHOR_CENTER && !trackCenterIndex.empty() ) {
+				int trackId = frames[frameId].superpixelTrackId[controlPoint.superpixelIndex];
+				auto it = trackCenterIndex.find( trackId );
+				if ( it != trackCenterIndex.end() && it->second >= 0 ) {
+					// The temporal term follows the centers, so the flow is the displacement to the matched one.
+					controlPoint.flow = controlPoints[it->second].originPos - controlPoint.originPos;
+					controlPoint.AddTemporalNeighbor( vector<BaryCoord>( 1, BaryCoord( 1.0, it->second ) ) );
+					temporalControlPointIndex.push_back( curFramePointIndex );
+					continue;
+				}
+			}
+
 			vector<BaryCoord> baryCoord;
 			int locateStatus = LocatePoint( subdiv, controlPointsMap[frameId + 1], nextFramePos, baryCoord );
 			if ( locateStatus == CV_PTLOC_INSIDE || locateStatus == CV_PTLOC_ON_EDGE || locateStatus == CV_PTLOC_VERTEX ) {
@@ -811,6 +884,10 @@ void Deformation::AddTemporalNeighbors() {
 	
 }
 
+void Deformation::SetAdjacencyGraph( bool enable ) {
+	useAdjacencyGraph = enable;
+}
+
 void Deformation::InitDeformation( double _deformedScaleX, double _deformedScaleY ) {
 
 	printf( "Initialize deformation.\n" );
@@ -819,13 +896,29 @@ void Deformation::InitDeformation( double _deformedScaleX, double _deformedScale
 	deformedScaleY = _deformedScaleY;
 	deformedFrameSize = Size( CeilToInt( frameSize.width * deformedScaleX ), CeilToInt( frameSize.height * deformedScaleY ) );
 
-	BuildControlPoints();
-	AddSpatialNeighbors();
-	AddTemporalNeighbors();
+	// The control graph only depends on the key frames, later targets reuse it and the factorization.
+	if ( !controlGraphBuilt ) {
+		BuildControlPoints();
+		AddSpatialNeighbors();
+		AddTemporalNeighbors();
+		// From here on the control graph owns the points, the build time list and its neighbor vectors go away.
+		controlGraph.Build( controlPoints );
+		vector<ControlPoint>().swap( controlPoints );
+		controlGraphBuilt = true;
+
+#ifdef DEBUG_DELAUNAY_DIVIDE
+		for ( int i = 0; i < frameNum; i++ ) {
+			Mat img;
+			DrawEdge( i, ORIGIN_POS_WITH_FRAME, img );
+			imshow( "Edge", img );
+			waitKey( 0 );
+		}
+#endif
+	}
 
-	for ( auto &controlPoint : controlPoints ) {
-		controlPoint.pos.x *= deformedScaleX;
-		controlPoint.pos.y *= deformedScaleY;
+	for ( int i = 0; i < controlPointsNum; i++ ) {
+		controlGraph.pos[i].x = controlGraph.originPos[i].x * deformedScaleX;
+		controlGraph.pos[i].y = controlGraph.originPos[i].y * deformedScaleY;
 	}
 
 #ifdef DEBUG_INIT_DEFORMATION
@@ -842,16 +935,17 @@ double Deformation::CalcSaliencyEnergy() {
 	for ( const auto &centerPointIndex : centerControlPointIndex ) {
 
 		double tmpEnergy = 0;
-		const ControlPoint &centerPoint = controlPoints[centerPointIndex];
+		const Point2f centerPos = controlGraph.pos[centerPointIndex];
+		const Point2f centerOriginPos = controlGraph.originPos[centerPointIndex];
 
-		for ( const auto &boundPointIndex : centerPoint.boundNeighbors ) {
+		for ( int k = controlGraph.boundPtr[centerPointIndex]; k < controlGraph.boundPtr[centerPointIndex + 1]; k++ ) {
 
-			const ControlPoint &boundPoint = controlPoints[boundPointIndex];
-			tmpEnergy += SqrNormL2( (centerPoint.pos - boundPoint.pos) - (centerPoint.originPos - boundPoint.originPos) );
+			int boundPointIndex = controlGraph.boundIndex[k];
+			tmpEnergy += SqrNormL2( (centerPos - controlGraph.pos[boundPointIndex]) - (centerOriginPos - controlGraph.originPos[boundPointIndex]) );
 
 		}
 
-		saliencyEnergy += centerPoint.saliency * tmpEnergy;
+		saliencyEnergy += controlGraph.saliency[centerPointIndex] * tmpEnergy;
 
 	}
 
@@ -867,18 +961,18 @@ double Deformation::CalcObjectEnergy() {
 
 	for ( const auto &centerPointIndex : centerControlPointIndex ) {
 
-		const ControlPoint &centerPoint = controlPoints[centerPointIndex];
+		const double saliency = controlGraph.saliency[centerPointIndex];
 
-		for ( const auto &boundPointIndex : centerPoint.boundNeighbors ) {
+		for ( int k = controlGraph.boundPtr[centerPointIndex]; k < controlGraph.boundPtr[centerPointIndex + 1]; k++ ) {
 
-			const ControlPoint &boundPoint = controlPoints[boundPointIndex];
+			int boundPointIndex = controlGraph.boundIndex[k];
 
-			Point2f originVec = boundPoint.originPos - centerPoint.originPos;
-			Point2f vec = boundPoint.pos - centerPoint.pos;
+			Point2f originVec = controlGraph.originPos[boundPointIndex] - controlGraph.originPos[centerPointIndex];
+			Point2f vec = controlGraph.pos[boundPointIndex] - controlGraph.pos[centerPointIndex];
 			double xRatio = (abs( originVec.x ) < SMALL_LEN) ? deformedScaleX : vec.x / originVec.x;
 			double yRatio = (abs( originVec.y ) < SMALL_LEN) ? deformedScaleY : vec.y / originVec.y;
 
-			objectEnergy += centerPoint.saliency * sqr( xRatio - yRatio );
+			objectEnergy += saliency * sqr( xRatio - yRatio );
 
 		}
 
@@ -899,11 +993,12 @@ double Deformation::CalcStructureEnergy() {
 		Point2f sum( 0, 0 );
 		Point2f squaredSum( 0, 0 );
 		for ( const auto &controlPointIndex : spatialEdge ) {
-			const ControlPoint &p = controlPoints[controlPointIndex];
-			sum.x += CalcRatio( p.pos.x, p.originPos.x );
-			sum.y += CalcRatio( p.pos.y, p.originPos.y );
-			squaredSum.x += sqr( CalcRatio( p.pos.x, p.originPos.x ) );
-			squaredSum.y += sqr( CalcRatio( p.pos.y, p.originPos.y ) );
+			const Point2f &pos = controlGraph.pos[controlPointIndex];
+			const Point2f &originPos = controlGraph.originPos[controlPointIndex];
+			sum.x += CalcRatio( pos.x, originPos.x );
+			sum.y += CalcRatio( pos.y, originPos.y );
+			squaredSum.x += sqr( CalcRatio( pos.x, originPos.x ) );
+			squaredSum.y += sqr( CalcRatio( pos.y, originPos.y ) );
 		}
 		
 		structureEnergy += 1.0f / spatialEdge.size() * (squaredSum.x + squaredSum.y)
@@ -925,18 +1020,19 @@ double Deformation::CalcTemporalEnergy() {
 
 	for ( auto &controlPointIndex : temporalControlPointIndex ) {
 
-		const ControlPoint &controlPoint = controlPoints[controlPointIndex];
-
-		Point2f nextFramePointPos = CalcPointByBaryCoord( controlPoint.temporalNeighbors, DEFORMED_POS );
+		Point2f nextFramePointPos = controlGraph.TemporalPos( controlPointIndex );
+		const Point2f &pos = controlGraph.pos[controlPointIndex];
+		const Point2f &flow = controlGraph.flow[controlPointIndex];
 		
 #ifdef DEBUG_CALC_TEMPORAL
-		cout << temporalEnergy << " " << nextFramePointPos << " " << controlPoint.pos << " " << controlPoint.flow << endl;
-		for ( size_t i = 0; i < controlPoint.temporalNeighbors.size(); i++ ) {
-			cout << "\tneighbors " << controlPoint.temporalNeighbors[i].first << " " << controlPoints[controlPoint.temporalNeighbors[i].second].pos << endl;
+		cout << temporalEnergy << " " << nextFramePointPos << " " << pos << " " << flow << endl;
+		for ( int k = controlGraph.temporalPtr[controlPointIndex]; k < controlGraph.temporalPtr[controlPointIndex + 1]; k++ ) {
+			cout << "\tneighbors " << controlGraph.temporalCoord[k].first << " " << controlGraph.pos[controlGraph.temporalCoord[k].second] << endl;
 		}
 #endif
 
-		temporalEnergy += SqrNormL2( (nextFramePointPos - controlPoint.pos) - controlPoint.flow );
+		Point2f deformedFlow( flow.x * deformedScaleX, flow.y * deformedScaleY );
+		temporalEnergy += SqrNormL2( (nextFramePointPos - pos) - deformedFlow );
 
 	}
 
@@ -962,37 +1058,40 @@ double Deformation::CalcEnergy() {
 
 }
 
-void Deformation::AddSaliencyConstraints( Mat &coefMat, Mat &constVec ) {
+void Deformation::AddSaliencyConstraints( SparseMatrix &coefMat, Mat &constVec ) {
 
 	for ( auto &centerPointIndex : centerControlPointIndex ) {
 
-		const ControlPoint &centerPoint = controlPoints[centerPointIndex];
+		const double saliency = controlGraph.saliency[centerPointIndex];
+		const Point2f &centerOriginPos = controlGraph.originPos[centerPointIndex];
 
-		double saliencySum = centerPoint.saliency * centerPoint.boundNeighbors.size();
+		double saliencySum = saliency * controlGraph.BoundNum( centerPointIndex );
 
 		// row centerPoint, col centerPoint
-		coefMat.at<float>( freeEleMap[2 * centerPointIndex], freeEleMap[2 * centerPointIndex] ) += ALPHA_SALIENCY * saliencySum;
-		coefMat.at<float>( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * centerPointIndex + 1] ) += ALPHA_SALIENCY * saliencySum;
+		coefMat.Add( freeEleMap[2 * centerPointIndex], freeEleMap[2 * centerPointIndex], ALPHA_SALIENCY * saliencySum );
+		coefMat.Add( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * centerPointIndex + 1], ALPHA_SALIENCY * saliencySum );
 
-		for ( auto &boundPointIndex : centerPoint.boundNeighbors ) {
+		for ( int k = controlGraph.boundPtr[centerPointIndex]; k < controlGraph.boundPtr[centerPointIndex + 1]; k++ ) {
 
-			const ControlPoint &boundPoint = controlPoints[boundPointIndex];
+			int boundPointIndex = controlGraph.boundIndex[k];
+			const Point2f &boundOriginPos = controlGraph.originPos[boundPointIndex];
+			const Point2f &boundPos = controlGraph.pos[boundPointIndex];
 
-			switch ( boundPoint.anchorType ) {
+			switch ( controlGraph.anchorType[boundPointIndex] ) {
 				case ControlPoint::ANCHOR_BOUND:
 
 					// row centerPoint, col boundPoint
-					coefMat.at<float>( freeEleMap[2 * centerPointIndex], freeEleMap[2 * boundPointIndex] ) -= ALPHA_SALIENCY * centerPoint.saliency;
-					coefMat.at<float>( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * boundPointIndex + 1] ) -= ALPHA_SALIENCY * centerPoint.saliency;
+					coefMat.Add( freeEleMap[2 * centerPointIndex], freeEleMap[2 * boundPointIndex], -ALPHA_SALIENCY * saliency );
+					coefMat.Add( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * boundPointIndex + 1], -ALPHA_SALIENCY * saliency );
 
 					// row boundPoint
-					coefMat.at<float>( freeEleMap[2 * boundPointIndex], freeEleMap[2 * centerPointIndex] ) -= ALPHA_SALIENCY * centerPoint.saliency;
-					coefMat.at<float>( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * centerPointIndex + 1] ) -= ALPHA_SALIENCY * centerPoint.saliency;
-					coefMat.at<float>( freeEleMap[2 * boundPointIndex], freeEleMap[2 * boundPointIndex] ) += ALPHA_SALIENCY * centerPoint.saliency;
-					coefMat.at<float>( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * boundPointIndex + 1] ) += ALPHA_SALIENCY * centerPoint.saliency;
+					coefMat.Add( freeEleMap[2 * boundPointIndex], freeEleMap[2 * centerPointIndex], -ALPHA_SALIENCY * saliency );
+					coefMat.Add( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * centerPointIndex + 1], -ALPHA_SALIENCY * saliency );
+					coefMat.Add( freeEleMap[2 * boundPointIndex], freeEleMap[2 * boundPointIndex], ALPHA_SALIENCY * saliency );
+					coefMat.Add( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * boundPointIndex + 1], ALPHA_SALIENCY * saliency );
 
-					constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) -= ALPHA_SALIENCY * centerPoint.saliency * (centerPoint.originPos.x - boundPoint.originPos.x);
-					constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) -= ALPHA_SALIENCY * centerPoint.saliency * (centerPoint.originPos.y - boundPoint.originPos.y);
+					constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) -= ALPHA_SALIENCY * saliency * (centerOriginPos.x - boundOriginPos.x);
+					constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) -= ALPHA_SALIENCY * saliency * (centerOriginPos.y - boundOriginPos.y);
 
 					break;
 
@@ -1000,13 +1099,13 @@ void Deformation::AddSaliencyConstraints( Mat &coefMat, Mat &constVec ) {
 				case ControlPoint::ANCHOR_STATIC_RIGHT:
 
 					// row centerPoint
-					constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) += ALPHA_SALIENCY * centerPoint.saliency * boundPoint.pos.x;
-					coefMat.at<float>( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * boundPointIndex + 1] ) -= ALPHA_SALIENCY * centerPoint.saliency;
+					constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) += ALPHA_SALIENCY * saliency * boundPos.x;
+					coefMat.Add( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * boundPointIndex + 1], -ALPHA_SALIENCY * saliency );
 
 					// row boundPoint
-					coefMat.at<float>( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * centerPointIndex + 1] ) -= ALPHA_SALIENCY * centerPoint.saliency;
-					coefMat.at<float>( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * boundPointIndex + 1] ) += ALPHA_SALIENCY * centerPoint.saliency;
-					constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) -= ALPHA_SALIENCY * centerPoint.saliency * (centerPoint.originPos.y - boundPoint.originPos.y);
+					coefMat.Add( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * centerPointIndex + 1], -ALPHA_SALIENCY * saliency );
+					coefMat.Add( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * boundPointIndex + 1], ALPHA_SALIENCY * saliency );
+					constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) -= ALPHA_SALIENCY * saliency * (centerOriginPos.y - boundOriginPos.y);
 
 					break;
 
@@ -1014,21 +1113,21 @@ void Deformation::AddSaliencyConstraints( Mat &coefMat, Mat &constVec ) {
 				case ControlPoint::ANCHOR_STATIC_BOTTOM:
 
 					// row centerPoint
-					coefMat.at<float>( freeEleMap[2 * centerPointIndex], freeEleMap[2 * boundPointIndex] ) -= ALPHA_SALIENCY * centerPoint.saliency;
-					constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) += ALPHA_SALIENCY * centerPoint.saliency * boundPoint.pos.y;
+					coefMat.Add( freeEleMap[2 * centerPointIndex], freeEleMap[2 * boundPointIndex], -ALPHA_SALIENCY * saliency );
+					constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) += ALPHA_SALIENCY * saliency * boundPos.y;
 
 					// row boundPoint
-					coefMat.at<float>( freeEleMap[2 * boundPointIndex], freeEleMap[2 * centerPointIndex] ) -= ALPHA_SALIENCY * centerPoint.saliency;
-					coefMat.at<float>( freeEleMap[2 * boundPointIndex], freeEleMap[2 * boundPointIndex] ) += ALPHA_SALIENCY * centerPoint.saliency;
-					constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) -= ALPHA_SALIENCY * centerPoint.saliency * (centerPoint.originPos.x - boundPoint.originPos.x);
+					coefMat.Add( freeEleMap[2 * boundPointIndex], freeEleMap[2 * centerPointIndex], -ALPHA_SALIENCY * saliency );
+					coefMat.Add( freeEleMap[2 * boundPointIndex], freeEleMap[2 * boundPointIndex], ALPHA_SALIENCY * saliency );
+					constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) -= ALPHA_SALIENCY * saliency * (centerOriginPos.x - boundOriginPos.x);
 
 					break;
 
 				case ControlPoint::ANCHOR_STATIC:
 
 					// row centerPoint
-					constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) += ALPHA_SALIENCY * centerPoint.saliency * boundPoint.pos.x;
-					constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) += ALPHA_SALIENCY * centerPoint.saliency * boundPoint.pos.y;
+					constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) += ALPHA_SALIENCY * saliency * boundPos.x;
+					constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) += ALPHA_SALIENCY * saliency * boundPos.y;
 
 					break;
 
@@ -1038,8 +1137,8 @@ void Deformation::AddSaliencyConstraints( Mat &coefMat, Mat &constVec ) {
 			}
 
 			// row centerPoint
-			constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) += ALPHA_SALIENCY * centerPoint.saliency * (centerPoint.originPos.x - boundPoint.originPos.x);
-			constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) += ALPHA_SALIENCY * centerPoint.saliency * (centerPoint.originPos.y - boundPoint.originPos.y);
+			constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) += ALPHA_SALIENCY * saliency * (centerOriginPos.x - boundOriginPos.x);
+			constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) += ALPHA_SALIENCY * saliency * (centerOriginPos.y - boundOriginPos.y);
 
 		}
 
@@ -1047,17 +1146,16 @@ void Deformation::AddSaliencyConstraints( Mat &coefMat, Mat &constVec ) {
 
 }
 
-void Deformation::AddObjectConstraints( Mat &coefMat, Mat &constVec ) {
+void Deformation::AddObjectConstraints( SparseMatrix &coefMat, Mat &constVec ) {
 
 	for ( const auto &centerPointIndex : centerControlPointIndex ) {
 
-		const ControlPoint &centerPoint = controlPoints[centerPointIndex];
-		const double saliency = centerPoint.saliency;
+		const double saliency = controlGraph.saliency[centerPointIndex];
 
-		for ( const auto &boundPointIndex : centerPoint.boundNeighbors ) {
+		for ( int k = controlGraph.boundPtr[centerPointIndex]; k < controlGraph.boundPtr[centerPointIndex + 1]; k++ ) {
 
-			const ControlPoint &boundPoint = controlPoints[boundPointIndex];
-			Point2f originVec = boundPoint.originPos - centerPoint.originPos;
+			int boundPointIndex = controlGraph.boundIndex[k];
+			Point2f originVec = controlGraph.originPos[boundPointIndex] - controlGraph.originPos[centerPointIndex];
 			Point2f invOriginVec;
 
 			invOriginVec.x = (abs( originVec.x ) < SMALL_LEN) ? 0 : 1 / originVec.x;
@@ -1075,50 +1173,50 @@ void Deformation::AddObjectConstraints( Mat &coefMat, Mat &constVec ) {
 			} else {
 				if ( freeEleMap[2 * boundPointIndex] != -1 ) {
 					if ( freeEleMap[2 * boundPointIndex] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * boundPointIndex], freeEleMap[2 * boundPointIndex] ) += ALPHA_OBJECT * saliency * sqr( invOriginVec.x );
+						coefMat.Add( freeEleMap[2 * boundPointIndex], freeEleMap[2 * boundPointIndex], ALPHA_OBJECT * saliency * sqr( invOriginVec.x ) );
 					} else {
-						constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) -= ALPHA_OBJECT * saliency * controlPoints[boundPointIndex].pos.x * sqr( invOriginVec.x );
+						constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) -= ALPHA_OBJECT * saliency * controlGraph.pos[boundPointIndex].x * sqr( invOriginVec.x );
 					}
 					if ( freeEleMap[2 * centerPointIndex] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * boundPointIndex], freeEleMap[2 * centerPointIndex] ) -= ALPHA_OBJECT * saliency * sqr( invOriginVec.x );
+						coefMat.Add( freeEleMap[2 * boundPointIndex], freeEleMap[2 * centerPointIndex], -ALPHA_OBJECT * saliency * sqr( invOriginVec.x ) );
 					} else {
-						constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) += ALPHA_OBJECT * saliency * controlPoints[centerPointIndex].pos.x * sqr( invOriginVec.x );
+						constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) += ALPHA_OBJECT * saliency * controlGraph.pos[centerPointIndex].x * sqr( invOriginVec.x );
 					}
 				}
 				if ( freeEleMap[2 * centerPointIndex] != -1 ) {
 					if ( freeEleMap[2 * boundPointIndex] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * centerPointIndex], freeEleMap[2 * boundPointIndex] ) -= ALPHA_OBJECT * saliency * sqr( invOriginVec.x );
+						coefMat.Add( freeEleMap[2 * centerPointIndex], freeEleMap[2 * boundPointIndex], -ALPHA_OBJECT * saliency * sqr( invOriginVec.x ) );
 					} else {
-						constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) += ALPHA_OBJECT * saliency * controlPoints[boundPointIndex].pos.x * sqr( invOriginVec.x );
+						constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) += ALPHA_OBJECT * saliency * controlGraph.pos[boundPointIndex].x * sqr( invOriginVec.x );
 					}
 					if ( freeEleMap[2 * centerPointIndex] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * centerPointIndex], freeEleMap[2 * centerPointIndex] ) += ALPHA_OBJECT * saliency * sqr( invOriginVec.x );
+						coefMat.Add( freeEleMap[2 * centerPointIndex], freeEleMap[2 * centerPointIndex], ALPHA_OBJECT * saliency * sqr( invOriginVec.x ) );
 					} else {
-						constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) -= ALPHA_OBJECT * saliency * controlPoints[centerPointIndex].pos.x * sqr( invOriginVec.x );
+						constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) -= ALPHA_OBJECT * saliency * controlGraph.pos[centerPointIndex].x * sqr( invOriginVec.x );
 					}
 				}
 				if ( freeEleMap[2 * boundPointIndex + 1] != -1 && abs( originVec.y ) > SMALL_LEN ) {
 					if ( freeEleMap[2 * boundPointIndex] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * boundPointIndex] ) -= ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y;
+						coefMat.Add( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * boundPointIndex], -ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y );
 					} else {
-						constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) += ALPHA_OBJECT * saliency * controlPoints[boundPointIndex].pos.x * invOriginVec.x * invOriginVec.y;
+						constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) += ALPHA_OBJECT * saliency * controlGraph.pos[boundPointIndex].x * invOriginVec.x * invOriginVec.y;
 					}
 					if ( freeEleMap[2 * centerPointIndex] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * centerPointIndex] ) += ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y;
+						coefMat.Add( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * centerPointIndex], ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y );
 					} else {
-						constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) -= ALPHA_OBJECT * saliency * controlPoints[centerPointIndex].pos.x * invOriginVec.x * invOriginVec.y;
+						constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) -= ALPHA_OBJECT * saliency * controlGraph.pos[centerPointIndex].x * invOriginVec.x * invOriginVec.y;
 					}
 				}
 				if ( freeEleMap[2 * centerPointIndex + 1] != -1 && abs( originVec.y ) > SMALL_LEN ) {
 					if ( freeEleMap[2 * boundPointIndex] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * boundPointIndex] ) += ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y;
+						coefMat.Add( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * boundPointIndex], ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y );
 					} else {
-						constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) -= ALPHA_OBJECT * saliency * controlPoints[boundPointIndex].pos.x * invOriginVec.x * invOriginVec.y;
+						constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) -= ALPHA_OBJECT * saliency * controlGraph.pos[boundPointIndex].x * invOriginVec.x * invOriginVec.y;
 					}
 					if ( freeEleMap[2 * centerPointIndex] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * centerPointIndex] ) -= ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y;
+						coefMat.Add( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * centerPointIndex], -ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y );
 					} else {
-						constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) += ALPHA_OBJECT * saliency * controlPoints[centerPointIndex].pos.x * invOriginVec.x * invOriginVec.y;
+						constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) += ALPHA_OBJECT * saliency * controlGraph.pos[centerPointIndex].x * invOriginVec.x * invOriginVec.y;
 					}
 				}
 			}
@@ -1133,51 +1231,51 @@ void Deformation::AddObjectConstraints( Mat &coefMat, Mat &constVec ) {
 			} else {
 				if ( freeEleMap[2 * boundPointIndex] != -1 && abs( originVec.x ) > SMALL_LEN ) {
 					if ( freeEleMap[2 * boundPointIndex + 1] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * boundPointIndex], freeEleMap[2 * boundPointIndex + 1] ) -= ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y;
+						coefMat.Add( freeEleMap[2 * boundPointIndex], freeEleMap[2 * boundPointIndex + 1], -ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y );
 					} else {
-						constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) += ALPHA_OBJECT * saliency * controlPoints[boundPointIndex].pos.y * invOriginVec.x * invOriginVec.y;
+						constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) += ALPHA_OBJECT * saliency * controlGraph.pos[boundPointIndex].y * invOriginVec.x * invOriginVec.y;
 					}
 					if ( freeEleMap[2 * centerPointIndex + 1] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * boundPointIndex], freeEleMap[2 * centerPointIndex + 1] ) += ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y;
+						coefMat.Add( freeEleMap[2 * boundPointIndex], freeEleMap[2 * centerPointIndex + 1], ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y );
 					} else {
-						constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) -= ALPHA_OBJECT * saliency * controlPoints[centerPointIndex].pos.y * invOriginVec.x * invOriginVec.y;
+						constVec.at<float>( freeEleMap[2 * boundPointIndex], 0 ) -= ALPHA_OBJECT * saliency * controlGraph.pos[centerPointIndex].y * invOriginVec.x * invOriginVec.y;
 					}
 				}
 				if ( freeEleMap[2 * centerPointIndex] != -1 && abs( originVec.x ) > SMALL_LEN ) {
 					if ( freeEleMap[2 * boundPointIndex + 1] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * centerPointIndex], freeEleMap[2 * boundPointIndex + 1] ) += ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y;
+						coefMat.Add( freeEleMap[2 * centerPointIndex], freeEleMap[2 * boundPointIndex + 1], ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y );
 					} else {
-						constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) -= ALPHA_OBJECT * saliency * controlPoints[boundPointIndex].pos.y * invOriginVec.x * invOriginVec.y;
+						constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) -= ALPHA_OBJECT * saliency * controlGraph.pos[boundPointIndex].y * invOriginVec.x * invOriginVec.y;
 					}
 					if ( freeEleMap[2 * centerPointIndex + 1] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * centerPointIndex], freeEleMap[2 * centerPointIndex + 1] ) -= ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y;
+						coefMat.Add( freeEleMap[2 * centerPointIndex], freeEleMap[2 * centerPointIndex + 1], -ALPHA_OBJECT * saliency * invOriginVec.x * invOriginVec.y );
 					} else {
-						constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) += ALPHA_OBJECT * saliency * controlPoints[centerPointIndex].pos.y * invOriginVec.x * invOriginVec.y;
+						constVec.at<float>( freeEleMap[2 * centerPointIndex], 0 ) += ALPHA_OBJECT * saliency * controlGraph.pos[centerPointIndex].y * invOriginVec.x * invOriginVec.y;
 					}
 
 				}
 				if ( freeEleMap[2 * boundPointIndex + 1] != -1 ) {
 					if ( freeEleMap[2 * boundPointIndex + 1] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * boundPointIndex + 1] ) += ALPHA_OBJECT * saliency * sqr( invOriginVec.y );
+						coefMat.Add( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * boundPointIndex + 1], ALPHA_OBJECT * saliency * sqr( invOriginVec.y ) );
 					} else {
-						constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) -= ALPHA_OBJECT * saliency * controlPoints[boundPointIndex].pos.y * sqr( invOriginVec.y );
+						constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) -= ALPHA_OBJECT * saliency * controlGraph.pos[boundPointIndex].y * sqr( invOriginVec.y );
 					}
 					if ( freeEleMap[2 * centerPointIndex + 1] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * centerPointIndex + 1] ) -= ALPHA_OBJECT * saliency * sqr( invOriginVec.y );
+						coefMat.Add( freeEleMap[2 * boundPointIndex + 1], freeEleMap[2 * centerPointIndex + 1], -ALPHA_OBJECT * saliency * sqr( invOriginVec.y ) );
 					} else {
-						constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) += ALPHA_OBJECT * saliency * controlPoints[centerPointIndex].pos.y * sqr( invOriginVec.y );
+						constVec.at<float>( freeEleMap[2 * boundPointIndex + 1], 0 ) += ALPHA_OBJECT * saliency * controlGraph.pos[centerPointIndex].y * sqr( invOriginVec.y );
 					}
 				}
 				if ( freeEleMap[2 * centerPointIndex + 1] != -1 ) {
 					if ( freeEleMap[2 * boundPointIndex + 1] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * boundPointIndex + 1] ) -= ALPHA_OBJECT * saliency * sqr( invOriginVec.y );
+						coefMat.Add( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * boundPointIndex + 1], -ALPHA_OBJECT * saliency * sqr( invOriginVec.y ) );
 					} else {
-						constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) += ALPHA_OBJECT * saliency * controlPoints[boundPointIndex].pos.y * sqr( invOriginVec.y );
+						constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) += ALPHA_OBJECT * saliency * controlGraph.pos[boundPointIndex].y * sqr( invOriginVec.y );
 					}
 					if ( freeEleMap[2 * centerPointIndex + 1] != -1 ) {
-						coefMat.at<float>( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * centerPointIndex + 1] ) += ALPHA_OBJECT * saliency * sqr( invOriginVec.y );
+						coefMat.Add( freeEleMap[2 * centerPointIndex + 1], freeEleMap[2 * centerPointIndex + 1], ALPHA_OBJECT * saliency * sqr( invOriginVec.y ) );
 					} else {
-						constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) -= ALPHA_OBJECT * saliency * controlPoints[centerPointIndex].pos.y * sqr( invOriginVec.y );
+						constVec.at<float>( freeEleMap[2 * centerPointIndex + 1], 0 ) -= ALPHA_OBJECT * saliency * controlGraph.pos[centerPointIndex].y * sqr( invOriginVec.y );
 					}
 				}
 			}
@@ -1195,31 +1293,31 @@ void Deformation::AddObjectConstraints( Mat &coefMat, Mat &constVec ) {
 
 }
 
-void Deformation::AddStructureConstraints( Mat &coefMat, Mat &constVec ) {
+void Deformation::AddStructureConstraints( SparseMatrix &coefMat, Mat &constVec ) {
 
 	for ( const auto &spatialEdge : spatialEdges ) {
 
 		int spatialNum = spatialEdge.size();
 		for ( const auto &controlPointIndex : spatialEdge ) {
 			
-			if ( controlPoints[controlPointIndex].anchorType != ControlPoint::ANCHOR_CENTER &&
-				 controlPoints[controlPointIndex].anchorType != ControlPoint::ANCHOR_BOUND ) {
+			if ( controlGraph.anchorType[controlPointIndex] != ControlPoint::ANCHOR_CENTER &&
+				 controlGraph.anchorType[controlPointIndex] != ControlPoint::ANCHOR_BOUND ) {
 				continue;
 			}
 			for ( const auto &colIndex : spatialEdge ) {
 
 				if ( controlPointIndex == colIndex ) {
-					coefMat.at<float>( freeEleMap[2 * controlPointIndex], freeEleMap[2 * colIndex] ) = ALPHA_STRUCTURE * 2.0f * (spatialNum - 1) / sqr( spatialNum );
-					coefMat.at<float>( freeEleMap[2 * controlPointIndex + 1], freeEleMap[2 * colIndex + 1] ) = ALPHA_STRUCTURE * 2.0f * (spatialNum - 1) / sqr( spatialNum );
+					coefMat.Add( freeEleMap[2 * controlPointIndex], freeEleMap[2 * colIndex], ALPHA_STRUCTURE * 2.0f * (spatialNum - 1) / sqr( spatialNum ) );
+					coefMat.Add( freeEleMap[2 * controlPointIndex + 1], freeEleMap[2 * colIndex + 1], ALPHA_STRUCTURE * 2.0f * (spatialNum - 1) / sqr( spatialNum ) );
 				} else {
 
-					if ( controlPoints[colIndex].anchorType != ControlPoint::ANCHOR_CENTER &&
-						 controlPoints[colIndex].anchorType != ControlPoint::ANCHOR_BOUND ) {
+					if ( controlGraph.anchorType[colIndex] != ControlPoint::ANCHOR_CENTER &&
+						 controlGraph.anchorType[colIndex] != ControlPoint::ANCHOR_BOUND ) {
 						constVec.at<float>( freeEleMap[2 * controlPointIndex], 0 ) += ALPHA_STRUCTURE * 2.0f / sqr( spatialNum );
 						constVec.at<float>( freeEleMap[2 * controlPointIndex + 1], 0 ) += ALPHA_STRUCTURE * 2.0f / sqr( spatialNum );
 					} else {
-						coefMat.at<float>( freeEleMap[2 * controlPointIndex], freeEleMap[2 * colIndex] ) = -ALPHA_STRUCTURE * 2.0f / sqr( spatialNum );
-						coefMat.at<float>( freeEleMap[2 * controlPointIndex + 1], freeEleMap[2 * colIndex + 1] ) = -ALPHA_STRUCTURE * 2.0f / sqr( spatialNum );
+						coefMat.Add( freeEleMap[2 * controlPointIndex], freeEleMap[2 * colIndex], -ALPHA_STRUCTURE * 2.0f / sqr( spatialNum ) );
+						coefMat.Add( freeEleMap[2 * controlPointIndex + 1], freeEleMap[2 * colIndex + 1], -ALPHA_STRUCTURE * 2.0f / sqr( spatialNum ) );
 					}
 					
 				}
@@ -1231,15 +1329,163 @@ void Deformation::AddStructureConstraints( Mat &coefMat, Mat &constVec ) {
 
 }
 
-void Deformation::AddTemporalConstraints( Mat &coefMat, Mat &constVec ) {
+void Deformation::AddTemporalConstraints( SparseMatrix &coefMat, Mat &constVec ) {
+
+}
+
+// Least squares factors of a block, the dense solve of DECOMP_NORMAL kept for every later right hand side.
+static void FactorDenseBlock( const SparseMatrix &blockMat, SVD &svd ) {
+
+	Mat dense;
+	blockMat.ToDense().convertTo( dense, CV_64FC1 );
+	svd( dense );
+
+}
+
+static void SolveDenseBlock( const SVD &svd, const vector<double> &b, vector<double> &x ) {
+
+	Mat denseX;
+	svd.backSubst( Mat( b ), denseX );
+	for ( size_t i = 0; i < x.size(); i++ ) {
+		x[i] = denseX.at<double>( (int)i, 0 );
+	}
 
 }
 
-void Deformation::OptimizeEnergyFunction() {
+/*
+Factors the independent blocks of the energy system, one per connected component
+of its non-zero pattern, e.g. one per keyframe while nothing couples the frames.
+A block spanning several keyframes gets a per frame block preconditioner for PCG.
+Only the blocks the sparse factorization fails on, or all with the dense solver,
+get dense factors.
+*/
+class EnergyFactorBody : public ParallelLoopBody {
+
+private:
+	const SparseMatrix &A;
+	const vector< vector<int> > &blockRows;
+	const vector<int> &rowFrame;
+	vector<SparseMatrix> &blockMats;
+	vector<SparseLDLT> &blockFactors;
+	vector<SparsePCG> &blockPCG;
+	vector<int> &blockFactored;
+	vector<SVD> &blockDense;
+
+public:
+	EnergyFactorBody( const SparseMatrix &_A, const vector< vector<int> > &_blockRows, const vector<int> &_rowFrame,
+					  vector<SparseMatrix> &_blockMats, vector<SparseLDLT> &_blockFactors, vector<SparsePCG> &_blockPCG,
+					  vector<int> &_blockFactored, vector<SVD> &_blockDense ) :
+		A( _A ), blockRows( _blockRows ), rowFrame( _rowFrame ), blockMats( _blockMats ), blockFactors( _blockFactors ),
+		blockPCG( _blockPCG ), blockFactored( _blockFactored ), blockDense( _blockDense ) {}
+
+	void operator()( const Range &range ) const {
+		for ( int k = range.start; k < range.end; k++ ) {
+
+			const vector<int> &rows = blockRows[k];
+			blockMats[k] = A.SubMatrix( rows );
+			blockFactored[k] = false;
+
+			if ( ENERGY_SOLVER == ENERGY_SOLVER_LDLT ) {
+				blockFactors[k].Analyze( blockMats[k] );
+				blockFactored[k] = blockFactors[k].Factorize( blockMats[k] );
+			}
+
+			if ( ENERGY_SOLVER != ENERGY_SOLVER_PCG ) {
+				if ( !blockFactored[k] ) FactorDenseBlock( blockMats[k], blockDense[k] );
+				continue;
+			}
+
+			SparsePCG &pcg = blockPCG[k];
+			pcg.SetTolerance( PCG_TOLERANCE );
+			pcg.SetMaxIterations( PCG_MAX_ITERS );
+			pcg.SetPreconditioner( PCG_INCOMPLETE_CHOLESKY ? SparsePCG::PRECOND_IC0 : SparsePCG::PRECOND_JACOBI );
+
+			map<int, int> frameBlock;
+			vector<int> blockOfRow( rows.size() );
+			for ( size_t i = 0; i < rows.size(); i++ ) {
+				auto it = frameBlock.insert( make_pair( rowFrame[rows[i]], (int)frameBlock.size() ) ).first;
+				blockOfRow[i] = it->second;
+			}
+			if ( frameBlock.size() > 1 ) {
+				pcg.SetPreconditioner( SparsePCG::PRECOND_BLOCK_JACOBI );
+				pcg.SetBlocks( blockOfRow );
+			}
+			pcg.Prepare( blockMats[k] );
+			blockFactored[k] = true;
+
+		}
+	}
+
+};
+
+/*
+Solves every block with the factors of EnergyFactorBody for a new right hand side,
+PCG starting from the given x. A block PCG does not converge on gets its dense
+factors here and keeps them for the later solves.
+*/
+class EnergySolveBody : public ParallelLoopBody {
+
+private:
+	const vector<double> &b;
+	vector<double> &x;
+	const vector< vector<int> > &blockRows;
+	const vector<SparseMatrix> &blockMats;
+	const vector<SparseLDLT> &blockFactors;
+	vector<SparsePCG> &blockPCG;
+	vector<int> &blockFactored;
+	vector<SVD> &blockDense;
+	vector<int> &blockSolved;
+
+public:
+	EnergySolveBody( const vector<double> &_b, vector<double> &_x, const vector< vector<int> > &_blockRows, const vector<SparseMatrix> &_blockMats,
+					 const vector<SparseLDLT> &_blockFactors, vector<SparsePCG> &_blockPCG, vector<int> &_blockFactored,
+					 vector<SVD> &_blockDense, vector<int> &_blockSolved ) :
+		b( _b ), x( _x ), blockRows( _blockRows ), blockMats( _blockMats ), blockFactors( _blockFactors ),
+		blockPCG( _blockPCG ), blockFactored( _blockFactored ), blockDense( _blockDense ), blockSolved( _blockSolved ) {}
+
+	void operator()( const Range &range ) const {
+		for ( int k = range.start; k < range.end; k++ ) {
+
+			const vector<int> &rows = blockRows[k];
+			vector<double> blockB( rows.size() ), blockX( rows.size() );
+			for ( size_t i = 0; i < rows.size(); i++ ) {
+				blockB[i] = b[rows[i]];
+				blockX[i] = x[rows[i]];
+			}
+
+			// Solved by the sparse solver 1, PCG failed 0, dense factors only -1.
+			blockSolved[k] = -1;
+			if ( blockFactored[k] ) {
+				if ( ENERGY_SOLVER == ENERGY_SOLVER_PCG ) {
+					blockSolved[k] = blockPCG[k].Solve( blockMats[k], blockB, blockX );
+				} else {
+					blockFactors[k].Solve( blockB, blockX );
+					blockSolved[k] = 1;
+				}
+			}
+			if ( blockSolved[k] != 1 ) {
+				if ( blockFactored[k] ) {
+					FactorDenseBlock( blockMats[k], blockDense[k] );
+					blockFactored[k] = false;
+				}
+				SolveDenseBlock( blockDense[k], blockB, blockX );
+			}
 
-#define OPTIMIZE_ENERGY_FUNC
+			// Blocks own disjoint rows, so the writes do not overlap.
+			for ( size_t i = 0; i < rows.size(); i++ ) {
+				x[rows[i]] = blockX[i];
+			}
 
-	Mat coefMat( freeEleNum, freeEleNum, CV_32FC1, Scalar( 0 ) );
+		}
+	}
+
+};
+
+void Deformation::BuildEnergySystem() {
+
+	int64 startTick = getTickCount();
+
+	SparseMatrix coefMat( freeEleNum, freeEleNum );
 	Mat constVec( freeEleNum, 1, CV_32FC1, Scalar( 0 ) );
 
 	AddSaliencyConstraints( coefMat, constVec );
@@ -1247,47 +1493,144 @@ void Deformation::OptimizeEnergyFunction() {
 	// AddStructureConstraints( coefMat, constVec );
 	// AddTemporalConstraints( coefMat, constVec );
 
-	Mat tmpCoefMat( 10, 10, CV_32FC1, Scalar( 0 ) );
-	Mat tmpConstVec( 10, 1, CV_32FC1, Scalar( 0 ) );
+	coefMat.Compress();
 
-#ifdef OPTIMIZE_ENERGY_FUNC
-	//coefMat( Rect( 0, 0, 5, 5 ) ).copyTo( tmpCoefMat( Rect( 0, 0, 5, 5 ) ) );
-	//coefMat( Rect( 8, 8, 5, 5 ) ).copyTo( tmpCoefMat( Rect( 5, 5, 5, 5 ) ) );
-	//constVec( Rect( 0, 0, 1, 5 ) ).copyTo( tmpConstVec( Rect( 0, 0, 1, 5 ) ) );
-	//constVec( Rect( 0, 8, 1, 5 ) ).copyTo( tmpConstVec( Rect( 0, 5, 1, 5 ) ) );
-	//
-	//cout << tmpCoefMat << endl << tmpConstVec << endl;
-
-	//coefMat = tmpCoefMat.clone();
-	//constVec = tmpConstVec.clone();
-#endif
+	vector<double> b( freeEleNum );
+	for ( int i = 0; i < freeEleNum; i++ ) {
+		b[i] = constVec.at<float>( i, 0 );
+	}
 
-	Mat resVec;
-	bool t = solve( coefMat, constVec, resVec, DECOMP_NORMAL );
-	cout << "solve " << t << endl;
+	// The builders give a symmetric system; otherwise solve the normal equations like DECOMP_NORMAL.
+	bool symmetric = coefMat.IsSymmetric( 1e-5 );
+	if ( symmetric ) {
+		energyConst = b;
+	} else {
+		coefMat.MultiplyTranspose( b, energyConst );
+	}
 
-#ifdef OPTIMIZE_ENERGY_FUNC
-	// cout << coefMat << endl;
-	// cout << constVec << endl;
-	// cout << resVec << endl;
+	// The target scale only enters the right hand side, the matrices and their factors stay valid.
+	if ( energyMatBuilt ) {
+		printf( "\tEnergy system: %d variables, reused %d blocks, %.2lf ms.\n", freeEleNum, (int)energySystem.blockRows.size(),
+				(getTickCount() - startTick) * 1000.0 / getTickFrequency() );
+		return;
+	}
 
-	//Mat tmpResVec( 16, 1, CV_32FC1, Scalar( 0 ) );
-	//resVec( Rect( 0, 0, 1, 5 ) ).copyTo( tmpResVec( Rect( 0, 0, 1, 5 ) ) );
-	//resVec( Rect( 0, 5, 1, 5 ) ).copyTo( tmpResVec( Rect( 0, 8, 1, 5 ) ) );
-	//resVec = tmpResVec.clone();
+	energySystem.mat = symmetric ? coefMat : coefMat.NormalMatrix();
 
-#endif
+	// Proximal term sum w_i (x_i - x_k,i)^2 keeps a step close to the projected positions x_k.
+	// w_i follows the diagonal of A, so every row is damped by the same fraction whatever its scale.
+	const SparseMatrix &A = energySystem.mat;
+	proximalWeight.assign( freeEleNum, ENERGY_PROXIMAL_WEIGHT );
+	proximalSystem.mat = SparseMatrix( freeEleNum, freeEleNum );
+	for ( int i = 0; i < freeEleNum; i++ ) {
+		for ( int k = A.rowPtr[i]; k < A.rowPtr[i + 1]; k++ ) {
+			proximalSystem.mat.Add( i, A.colIndex[k], A.values[k] );
+		}
+		double diag = A.At( i, i );
+		if ( diag > VERY_SMALL ) proximalWeight[i] = ENERGY_PROXIMAL_WEIGHT * diag;
+		proximalSystem.mat.Add( i, i, proximalWeight[i] );
+	}
+	proximalSystem.mat.Compress();
 
+	vector<int> rowFrame( freeEleNum, 0 );
 	for ( int i = 0; i < controlPointsNum; i++ ) {
-		if ( freeEleMap[2 * i] != -1 ) controlPoints[i].pos.x = resVec.at<float>( freeEleMap[2 * i], 0 );
-		if ( freeEleMap[2 * i + 1] != -1 ) controlPoints[i].pos.y = resVec.at<float>( freeEleMap[2 * i + 1], 0 );
+		if ( freeEleMap[2 * i] != -1 ) rowFrame[freeEleMap[2 * i]] = controlGraph.frameId[i];
+		if ( freeEleMap[2 * i + 1] != -1 ) rowFrame[freeEleMap[2 * i + 1]] = controlGraph.frameId[i];
+	}
+
+	FactorEnergySystem( energySystem, rowFrame );
+	FactorEnergySystem( proximalSystem, rowFrame );
+	energyMatBuilt = true;
+
+	int denseBlockNum = 0, proximalDenseBlockNum = 0;
+	for ( int factored : energySystem.blockFactored ) denseBlockNum += !factored;
+	for ( int factored : proximalSystem.blockFactored ) proximalDenseBlockNum += !factored;
+	printf( "\tEnergy system: %d variables, %d non-zeros, %d blocks, %d dense, proximal %d dense, in %.2lf ms.\n", freeEleNum, coefMat.NonZeroNum(),
+			(int)energySystem.blockRows.size(), denseBlockNum, proximalDenseBlockNum, (getTickCount() - startTick) * 1000.0 / getTickFrequency() );
+
+	if ( ENERGY_SOLVER == ENERGY_SOLVER_LDLT ) {
+		// Fill of the minimum degree ordering, L against the strictly lower part of the matrix.
+		int factorNonZeros = 0;
+		for ( const auto &factor : energySystem.blockFactors ) {
+			factorNonZeros += factor.FactorNonZeroNum();
+		}
+		int lowerNonZeros = (energySystem.mat.NonZeroNum() - freeEleNum) / 2;
+		printf( "\tLDLT fill: %d non-zeros in L, %.2lf per lower non-zero.\n", factorNonZeros, (double)factorNonZeros / max( lowerNonZeros, 1 ) );
+	}
+
+}
+
+void Deformation::FactorEnergySystem( EnergySystem &system, const vector<int> &rowFrame ) {
+
+	vector<int> component( freeEleNum, 0 );
+	int componentNum = ENERGY_BLOCK_PARALLEL ? system.mat.ConnectedComponents( component ) : 1;
+	system.blockRows.assign( componentNum, vector<int>() );
+	for ( int i = 0; i < freeEleNum; i++ ) {
+		system.blockRows[component[i]].push_back( i );
+	}
+
+	system.blockMats.assign( componentNum, SparseMatrix() );
+	system.blockFactors.assign( componentNum, SparseLDLT() );
+	system.blockPCG.assign( componentNum, SparsePCG() );
+	system.blockFactored.assign( componentNum, 0 );
+	system.blockDense.assign( componentNum, SVD() );
+	parallel_for_( Range( 0, componentNum ), EnergyFactorBody( system.mat, system.blockRows, rowFrame,
+		system.blockMats, system.blockFactors, system.blockPCG, system.blockFactored, system.blockDense ) );
+
+}
+
+void Deformation::SolveEnergySystem( EnergySystem &system, const vector<double> &rhs, vector<double> &x ) {
+
+	int blockNum = system.blockRows.size();
+	vector<int> blockSolved( blockNum, 0 );
+	parallel_for_( Range( 0, blockNum ), EnergySolveBody( rhs, x, system.blockRows, system.blockMats,
+		system.blockFactors, system.blockPCG, system.blockFactored, system.blockDense, blockSolved ) );
+
+	if ( ENERGY_SOLVER == ENERGY_SOLVER_PCG ) {
+		// Relative residual ||b - Ax|| / ||b|| of every block PCG ran on, a block stopped by the cap did not converge.
+		for ( int k = 0; k < blockNum; k++ ) {
+			if ( blockSolved[k] < 0 ) continue;
+			const SparsePCG &pcg = system.blockPCG[k];
+			printf( "\t\tPCG block %d: %d rows, %d iterations, residual %.3e%s%s.\n", k, (int)system.blockRows[k].size(),
+					pcg.GetIterations(), pcg.GetResidual(), pcg.GetIterations() >= PCG_MAX_ITERS ? ", hit PCG_MAX_ITERS" : "",
+					blockSolved[k] ? "" : ", dense from now on" );
+		}
+	}
+
+}
+
+void Deformation::OptimizeEnergyFunction( bool proximal ) {
+
+// #define OPTIMIZE_ENERGY_FUNC
+
+	// Either the exact solve A x = b or one proximal step (A + W) x = b + W x_k, the factors only see a new right hand side.
+	EnergySystem &system = proximal ? proximalSystem : energySystem;
+	vector<double> rhs( energyConst ), x( freeEleNum, 0 );
+	for ( int i = 0; i < controlPointsNum; i++ ) {
+		int row = freeEleMap[2 * i];
+		if ( row != -1 ) {
+			x[row] = controlGraph.pos[i].x;
+			if ( proximal ) rhs[row] += proximalWeight[row] * controlGraph.pos[i].x;
+		}
+		row = freeEleMap[2 * i + 1];
+		if ( row != -1 ) {
+			x[row] = controlGraph.pos[i].y;
+			if ( proximal ) rhs[row] += proximalWeight[row] * controlGraph.pos[i].y;
+		}
+	}
+
+	SolveEnergySystem( system, rhs, x );
+
+	for ( int i = 0; i < controlPointsNum; i++ ) {
+		if ( freeEleMap[2 * i] != -1 ) controlGraph.pos[i].x = (float)x[freeEleMap[2 * i]];
+		if ( freeEleMap[2 * i + 1] != -1 ) controlGraph.pos[i].y = (float)x[freeEleMap[2 * i + 1]];
 	}
 
 #ifdef OPTIMIZE_ENERGY_FUNC
 	for ( int i = 0; i < controlPointsNum; i++ ) {
-		if ( controlPoints[i].frameId != 0 ) break;
-		cout << controlPoints[i].originPos << " " << controlPoints[i].pos << " " << controlPoints[i].saliency << " ";
-		switch ( controlPoints[i].anchorType ) {
+		if ( controlGraph.frameId[i] != 0 ) break;
+		cout << controlGraph.originPos[i] << " " << controlGraph.pos[i] << " " << controlGraph.saliency[i] << " ";
+		switch ( controlGraph.anchorType[i] ) {
 			case ControlPoint::ANCHOR_CENTER:
 				cout << "CENTER" << endl;
 				break;
@@ -1324,25 +1667,25 @@ void Deformation::CollinearConstraints() {
 
 	for ( int i = 0; i < controlPointsNum; i++ ) {
 
-		if ( controlPoints[i].anchorType != ControlPoint::ANCHOR_BOUND ) continue;
+		if ( controlGraph.anchorType[i] != ControlPoint::ANCHOR_BOUND ) continue;
 
-		Point2f p0 = controlPoints[i].pos;
-		Point2f p1 = controlPoints[controlPoints[i].boundNeighbors[0]].pos;
-		Point2f p2 = controlPoints[controlPoints[i].boundNeighbors[1]].pos;
+		Point2f p0 = controlGraph.pos[i];
+		Point2f p1 = controlGraph.pos[controlGraph.boundIndex[controlGraph.boundPtr[i]]];
+		Point2f p2 = controlGraph.pos[controlGraph.boundIndex[controlGraph.boundPtr[i] + 1]];
 
 		Point2f u1 = p0 - p1;
 		Point2f u2 = p2 - p1;
 
 		double norm = NormL2( u2 );
 		if ( SignNumber( norm ) == 0 ) {
-			controlPoints[i].pos = p1;
+			controlGraph.pos[i] = p1;
 			continue;
 		}
 
 		double projection = DotProduct( u1, u2 ) / sqr( norm );
 
 		projection = max( min( projection, 1.0 ), 0.0 );
-		controlPoints[i].pos = p1 + projection * u2;
+		controlGraph.pos[i] = p1 + projection * u2;
 
 	}
 
@@ -1354,10 +1697,10 @@ void Deformation::UpdateControlPoints() {
 
 	for ( int i = 0; i < controlPointsNum; i++ ) {
 
-		switch ( controlPoints[i].anchorType ) {
+		switch ( controlGraph.anchorType[i] ) {
 			case ControlPoint::ANCHOR_BOUND:
 			case ControlPoint::ANCHOR_CENTER:
-				RestrictInside( controlPoints[i].pos, deformedFrameSize );
+				RestrictInside( controlGraph.pos[i], deformedFrameSize );
 				break;
 			default:
 				break;
@@ -1378,12 +1721,50 @@ void Deformation::MinimizeEnergy() {
 	double energy = CalcEnergy();
 	printf( "\tInit Energy: %.3lf.\n", energy );
 
-	OptimizeEnergyFunction();
-	CollinearConstraints();
-	UpdateControlPoints();
+	int64 startTick = getTickCount();
+	BuildEnergySystem();
+
+	// Alternate the solve with projecting the bound points back onto their edges and the frame.
+	// Iteration 0 is the exact single solve, the proximal steps after it start from its projection.
+	int iter;
+	double maxIterMs = 0, singleSolveEnergy = 0;
+	vector<Point2f> singleSolvePos;
+	for ( iter = 0; iter < MIN_ENERGY_ITERS; iter++ ) {
+
+		int64 iterTick = getTickCount();
+
+		OptimizeEnergyFunction( iter > 0 );
+		CollinearConstraints();
+		UpdateControlPoints();
+
+		double newEnergy = CalcEnergy();
+		double iterMs = (getTickCount() - iterTick) * 1000.0 / getTickFrequency();
+		maxIterMs = max( maxIterMs, iterMs );
+		printf( "\tIteration %d: energy %.3lf, %.2lf ms.\n", iter, newEnergy, iterMs );
+
+		if ( iter == 0 ) {
+			singleSolveEnergy = newEnergy;
+			singleSolvePos = controlGraph.pos;
+		}
+
+		bool converged = abs( energy - newEnergy ) <= ENERGY_REL_TERMINATE * max( abs( energy ), VERY_SMALL );
+		energy = newEnergy;
+		if ( converged ) {
+			iter++;
+			break;
+		}
+
+	}
+
+	// The proximal steps are not guaranteed to descend once projected, never end above the single solve.
+	if ( energy > singleSolveEnergy ) {
+		controlGraph.pos = singleSolvePos;
+		energy = singleSolveEnergy;
+	}
 
-	energy = CalcEnergy();
-	printf( "\tOptimized Energy: %.3lf.\n", energy );
+	printf( "\tOptimized Energy: %.3lf, single solve %.3lf (%.2lf%%), %d iterations, %.2lf ms, at most %.2lf ms per iteration.\n",
+			energy, singleSolveEnergy, 100 * (energy - singleSolveEnergy) / max( abs( singleSolveEnergy ), VERY_SMALL ),
+			iter, (getTickCount() - startTick) * 1000.0 / getTickFrequency(), maxIterMs );
 
 #ifdef DEBUG_MIN_ENERGY
 	Mat edgeImg;
@@ -1402,14 +1783,13 @@ Point2f Deformation::CalcPointByBaryCoord( const vector<BaryCoord> &baryCoord, i
 
 	for ( const auto &vertex : baryCoord ) {
 		// cout << vertex.first << " " << vertex.second << endl;
-		ControlPoint point = controlPoints[vertex.second];
 		if ( posType == ORIGIN_POS ) {
 #ifdef DEBUG
-			// cout << vertex.first << " " << point.originPos << " ";
+			// cout << vertex.first << " " << controlGraph.originPos[vertex.second] << " ";
 #endif
-			deformedPoint += vertex.first * point.originPos;
+			deformedPoint += vertex.first * controlGraph.originPos[vertex.second];
 		} else {
-			deformedPoint += vertex.first * point.pos;
+			deformedPoint += vertex.first * controlGraph.pos[vertex.second];
 		}
 	}
 
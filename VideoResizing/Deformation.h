@@ -6,13 +6,42 @@
 #include "common.h"
 #include "KeyFrame.h"
 #include "ControlPoint.h"
+#include "ControlGraph.h"
+#include "SparseMatrix.h"
+#include "SparseLDLT.h"
+#include "SparsePCG.h"
 #include "io.h"
 
 typedef pair<int, int> Edge;
 
+// Control points of one key frame with frame local indices, before they are stitched into the shot.
+struct FrameControlGraph {
+	vector<ControlPoint> points;
+	Mat pointsMap;
+	int freeEleNum;
+};
+
+// One energy matrix split into the independent blocks of its non-zero pattern, each factored on its own.
+// A block the sparse solver fails on falls back to the cached SVD of the dense block.
+struct EnergySystem {
+	SparseMatrix mat;
+	vector< vector<int> > blockRows;
+	vector<SparseMatrix> blockMats;
+	vector<SparseLDLT> blockFactors;
+	vector<SparsePCG> blockPCG;
+	vector<int> blockFactored;
+	vector<SVD> blockDense;
+};
+
+// Flags the first inside edge of every center pair of a Delaunay edge list, pointsMap maps a center to its index.
+void MarkFirstEdges( const vector<Vec4f> &edgeList, const Mat &pointsMap, vector<bool> &edgeFirst );
+
 class Deformation {
 
 private:
+	friend class ControlGraphBuildBody;
+	friend class ControlGraphStitchBody;
+
 	string videoName;
 
 	vector<Point2f> staticPoints;
@@ -29,11 +58,24 @@ private:
 	
 	vector<Mat> deformedFrames;
 
+	// Build time list of the control points, released once controlGraph is built from it.
+	vector<ControlPoint> controlPoints;
+
+	// Energy system A x = b and its proximal copy A + W, factored once for all target scales.
+	bool useAdjacencyGraph;
+	bool controlGraphBuilt, energyMatBuilt;
+	vector<double> energyConst;
+	vector<double> proximalWeight;
+	EnergySystem energySystem, proximalSystem;
+
+	void AddBoundControlPoint( FrameControlGraph &graph, int frameId, int index0, int index1, const Point2f &neighborPoint ) const;
+	void AddStaticControlPoint( FrameControlGraph &graph, int frameId, const Point2f &point, int anchorType, int superpixelIndex, int controlPointIndex ) const;
+	void BuildFrameControlGraph( int frameId, FrameControlGraph &graph ) const;
 	void BuildControlPoints();
 	void AddTemporalNeighbors();
 	void AddSpatialNeighbors();
 
-	void DrawSubdiv( const Mat &, const Subdiv2D & );
+	void DrawSubdiv( const Mat &, const Subdiv2D & ) const;
 	void DrawEdge( int, int, Mat &edgeImg );
 	void DrawLocate( const Point2f &, const vector<BaryCoord> & );
 
@@ -44,18 +86,21 @@ private:
 	int LocatePoint( Subdiv2D &subdiv, const Mat &cpMap, const Point2f &p, vector<BaryCoord> &baryCoord );
 	Point2f CalcPointByBaryCoord( const vector<BaryCoord> &, int );
 
-	Point2f GetBoundPoint( int, int );
+	Point2f GetBoundPoint( const vector<ControlPoint> &, int, int ) const;
 
 	double CalcSaliencyEnergy();
 	double CalcObjectEnergy();
 	double CalcStructureEnergy();
 	double CalcTemporalEnergy();
 
-	void AddSaliencyConstraints( Mat &coefMat, Mat &constVec );
-	void AddObjectConstraints( Mat &coefMat, Mat &constVec );
-	void AddStructureConstraints( Mat &coefMat, Mat &constVec );
-	void AddTemporalConstraints( Mat &coefMat, Mat &constVec );
-	void OptimizeEnergyFunction();
+	void AddSaliencyConstraints( SparseMatrix &coefMat, Mat &constVec );
+	void AddObjectConstraints( SparseMatrix &coefMat, Mat &constVec );
+	void AddStructureConstraints( SparseMatrix &coefMat, Mat &constVec );
+	void AddTemporalConstraints( SparseMatrix &coefMat, Mat &constVec );
+	void BuildEnergySystem();
+	void FactorEnergySystem( EnergySystem &system, const vector<int> &rowFrame );
+	void SolveEnergySystem( EnergySystem &system, const vector<double> &rhs, vector<double> &x );
+	void OptimizeEnergyFunction( bool proximal );
 
 	void CollinearConstraints();
 	void UpdateControlPoints();
@@ -73,11 +118,15 @@ public:
 	Size frameSize, deformedFrameSize;
 	int frameNum;
 
-	vector<ControlPoint> controlPoints;
+	// Owns the control points once built, the energy, the drawing and the rendering all read it.
+	ControlGraph controlGraph;
 	vector<Mat> deformedMap;
 
 	Deformation( vector<KeyFrame> &, const string &_videoName );
 	
+	// Bound points from the region adjacency graph, or from Delaunay edges between the centers.
+	void SetAdjacencyGraph( bool enable );
+	// Builds the control graph on the first call, later calls only retarget it.
 	void InitDeformation( double, double );
 	double CalcEnergy();
 	void MinimizeEnergy();
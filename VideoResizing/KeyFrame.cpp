@@ -9,12 +9,12 @@ KeyFrame::KeyFrame( const Mat &_img, int _frameId ) {
 	size = img.size();
 	frameId = _frameId;
 
-	pixelLabel = Mat( rows, cols, CV_32SC1 );
 	cvtColor( img, grayImg, COLOR_BGR2GRAY );
 	img.convertTo( CIELabImg, CV_32FC3, 1.0 / 255 );
 	cvtColor( CIELabImg, CIELabImg, COLOR_BGR2Lab );
 
 	superpixelNum = MAX_SUPERPIXEL_NUM;
+	superpixelTracked = false;
 	opFlag = false;
 	edFlag = false;
 
@@ -32,10 +32,16 @@ void KeyFrame::FreeMemory() {
 	temporalContrastMap.release();
 	superpixelSpatialContrast.clear();
 	superpixelTemporalContrast.clear();
+	superpixelForwardMotion.clear();
+	superpixelBackwardMotion.clear();
 
 	forwardLocalMotionMap.release();
 	backwardLocalMotionMap.release();
 
+	pixelSaliencyMap.release();
+	saliencyMap.release();
+	saliencyMapSource.clear();
+
 }
 
 void KeyFrame::DrawImgWithContours( SLIC &slic ) {
@@ -114,47 +120,62 @@ void KeyFrame::QuantizeColorSpace(const vector<Vec3f> &_palette, const Mat &_pal
 	
 }
 
-void KeyFrame::SegSuperpixel() {
+void KeyFrame::SegSuperpixel( SlicWorkspace &workspace ) {
 
-	SLIC slic;
-	int *label;
-	
-	slic.GenerateSuperpixels(img, superpixelNum );
+	SLIC slic( workspace );
+	GenerateSuperpixel( slic, workspace );
+	superpixelTracked = false;
+
+}
+
+void KeyFrame::SegSuperpixel( const KeyFrame &prevFrame, SlicWorkspace &workspace ) {
+
+	// Advect the previous keyframe's centers along its forward flow and resample their color.
+	SlicSeeds seeds = prevFrame.superpixelSeeds;
+	for ( size_t i = 0; i < seeds.x.size(); i++ ) {
+
+		int px = min( max( RoundToInt( seeds.x[i] ), 0 ), cols - 1 );
+		int py = min( max( RoundToInt( seeds.y[i] ), 0 ), rows - 1 );
+		Point2f flow = prevFrame.forwardFlowMap.at<Point2f>( py, px );
+
+		seeds.x[i] = min( max( seeds.x[i] + flow.x, 0.0 ), (double)(cols - 1) );
+		seeds.y[i] = min( max( seeds.y[i] + flow.y, 0.0 ), (double)(rows - 1) );
+
+		Vec3f color = CIELabImg.at<Vec3f>( RoundToInt( seeds.y[i] ), RoundToInt( seeds.x[i] ) );
+		seeds.l[i] = color.val[0];
+		seeds.a[i] = color.val[1];
+		seeds.b[i] = color.val[2];
+
+	}
+
+	SLIC slic( workspace );
+	slic.SetInitialSeeds( seeds, SUPERPIXEL_WARM_ITERS, SUPERPIXEL_WARM_CONVERGE );
+	GenerateSuperpixel( slic, workspace );
+	superpixelTracked = true;
+
+}
+
+void KeyFrame::GenerateSuperpixel( SLIC &slic, SlicWorkspace &workspace ) {
+
+	// SLIC writes its labels into the workspace, only the 16 bit label map is kept.
+	slic.SetConvergence( SUPERPIXEL_CONVERGE_SHIFT, SUPERPIXEL_CONVERGE_CHANGE );
+	slic.SetProxyStep( SUPERPIXEL_PROXY_STEP );
+	slic.GenerateSuperpixelsFromLab( CIELabImg, superpixelNum, workspace.labelMat );
+	superpixelNum = slic.GetLabelNum();
+	labelMap.Build( workspace.labelMat );
 
 #ifdef DEBUG_SEG_SUPERPIXEL
 	DrawImgWithContours(slic);
 #endif
-	
-	label = slic.GetLabel();
-	superpixelNum = 0;
-	for ( int y = 0; y < rows; y++ ) {
-		for ( int x = 0; x < cols; x++ ) {
-			int pointIndex = y * cols + x;
-			int labelIndex = label[pointIndex];
-			pixelLabel.at<int>( y, x ) = labelIndex;
-			superpixelNum = max( superpixelNum, labelIndex );
-		}
-	}
 
-	superpixelNum++;
-	superpixelCard = vector<int>( superpixelNum, 0 );
-	superpixelCenter = vector<Point>( superpixelNum, Point( 0, 0 ) );
+	superpixelSeeds = slic.GetSeeds();
+	superpixelTrackId = slic.GetSeedOfLabel();
+	superpixelTrackId.resize( superpixelNum, -1 );
 
-	for ( int y = 0; y < rows; y++ ) {
-		for ( int x = 0; x < cols; x++ ) {
-			int labelIndex = pixelLabel.at<int>( y, x );
-			superpixelCard[labelIndex]++;
-			superpixelCenter[labelIndex] += Point( x, y );
-		}
-	}
-	
-	for ( int i = 0; i < superpixelNum; i++ ) {
-		superpixelCenter[i].x /= superpixelCard[i];
-		superpixelCenter[i].y /= superpixelCard[i];
-	}
-	
 #ifdef DEBUG_SEG_SUPERPIXEL
 	cout << "\tSuperpixel Num: " << superpixelNum << endl;
+	cout << "\tSLIC iterations: " << slic.GetStats().iterations << ", residual: " << slic.GetStats().residual
+		<< ", label changes: " << slic.GetStats().labelChanges << ", " << slic.GetStats().elapsedMs << " ms" << endl;
 	imgWithContours = slic.GetImgWithContours( cv::Scalar( 0, 0, 255 ) );
 	imshow( "Img with Contours", imgWithContours );
 	waitKey( 1 );
@@ -162,46 +183,109 @@ void KeyFrame::SegSuperpixel() {
 
 }
 
-void KeyFrame::MarkBoundLabel() {
+void KeyFrame::SetSupervoxelLabel( const int *label, int supervoxelNum ) {
 
-	superpixelBoundLabel = vector<int>( superpixelNum, BOUND_NONE );
+	// Number the supervoxels present in this frame compactly, keeping the shot wide label as track id.
+	vector<int> localLabel( supervoxelNum, -1 );
+	Mat pixelLabel( rows, cols, CV_32SC1 );
+	superpixelTrackId.clear();
+	superpixelSeeds = SlicSeeds();
 
 	for ( int y = 0; y < rows; y++ ) {
+		int *labelRow = pixelLabel.ptr<int>( y );
+		for ( int x = 0; x < cols; x++ ) {
+			int supervoxelIndex = label[y * cols + x];
+			if ( localLabel[supervoxelIndex] < 0 ) {
+				localLabel[supervoxelIndex] = superpixelTrackId.size();
+				superpixelTrackId.push_back( supervoxelIndex );
+			}
+			labelRow[x] = localLabel[supervoxelIndex];
+		}
+	}
 
-		int label;
+	superpixelNum = superpixelTrackId.size();
+	superpixelTracked = true;
+	labelMap.Build( pixelLabel );
 
-		label = pixelLabel.at<int>( y, 0 );
-		superpixelBoundLabel[label] = BOUND_LEFT;
+}
+
+void KeyFrame::ReduceSuperpixelStats() {
+
+	LabelReducer reducer( labelMap, superpixelNum );
+	reducer.AddPosition();
+	reducer.AddAdjacency();
+	if ( !paletteMap.empty() ) reducer.AddColorHist( paletteMap, palette.size() );
+	if ( !forwardLocalMotionMap.empty() ) reducer.AddMotion( forwardLocalMotionMap );
+	if ( !backwardLocalMotionMap.empty() ) reducer.AddMotion( backwardLocalMotionMap );
+	if ( !pixelSaliencyMap.empty() ) reducer.AddSaliency( pixelSaliencyMap );
 
-		label = pixelLabel.at<int>( y, cols - 1 );
-		superpixelBoundLabel[label] = BOUND_RIGHT;
+	LabelStats stats;
+	reducer.Reduce( stats );
+
+	superpixelCard = stats.card;
+	superpixelCenter = vector<Point>( superpixelNum, Point( 0, 0 ) );
+	superpixelBoundLabel = vector<int>( superpixelNum, BOUND_NONE );
+
+	for ( int i = 0; i < superpixelNum; i++ ) {
+
+		superpixelCenter[i].x = (int)(stats.sumX[i] / superpixelCard[i]);
+		superpixelCenter[i].y = (int)(stats.sumY[i] / superpixelCard[i]);
 
 	}
 
+	// Only the frame border is walked, in the old raster order so the last side written wins.
+	for ( int y = 0; y < rows; y++ ) {
+		superpixelBoundLabel[labelMap.At( y, 0 )] = BOUND_LEFT;
+		superpixelBoundLabel[labelMap.At( y, cols - 1 )] = BOUND_RIGHT;
+	}
 	for ( int x = 0; x < cols; x++ ) {
+		superpixelBoundLabel[labelMap.At( 0, x )] = BOUND_TOP;
+		superpixelBoundLabel[labelMap.At( rows - 1, x )] = BOUND_BOTTOM;
+	}
 
-		int label;
+	superpixelColorHist = stats.colorHist;
+	superpixelAdjacency = stats.adjacency;
 
-		label = pixelLabel.at<int>( 0, x );
-		superpixelBoundLabel[label] = BOUND_TOP;
+	// The adjacency is sorted by label pair, so every label0 owns one contiguous range.
+	adjacencyBegin.assign( superpixelNum + 1, 0 );
+	for ( const auto &adjacency : superpixelAdjacency ) {
+		adjacencyBegin[adjacency.label0 + 1]++;
+	}
+	for ( int i = 0; i < superpixelNum; i++ ) {
+		adjacencyBegin[i + 1] += adjacencyBegin[i];
+	}
 
-		label = pixelLabel.at<int>( rows - 1, x );
-		superpixelBoundLabel[label] = BOUND_BOTTOM;
+	int motionIndex = 0;
+	superpixelForwardMotion.clear();
+	superpixelBackwardMotion.clear();
+	if ( !forwardLocalMotionMap.empty() ) superpixelForwardMotion = stats.motionSum[motionIndex++];
+	if ( !backwardLocalMotionMap.empty() ) superpixelBackwardMotion = stats.motionSum[motionIndex++];
 
+	if ( !pixelSaliencyMap.empty() ) {
+		superpixelSaliency = stats.saliencySum;
+		for ( int i = 0; i < superpixelNum; i++ ) {
+			superpixelSaliency[i] /= superpixelCard[i];
+		}
+		NormalizeVec( superpixelSaliency );
+		pixelSaliencyMap.release();
 	}
 
 }
 
-void KeyFrame::CalcSuperpixelColorHist() {
+const vector<LabelAdjacency> &KeyFrame::GetAdjacency() const {
+	return superpixelAdjacency;
+}
 
-	superpixelColorHist = vector < vector<int> >( superpixelNum, vector<int>( palette.size(), 0 ) );
-	for ( int y = 0; y < rows; y++ ) {
-		for ( int x = 0; x < cols; x++ ) {
-			int labelIndex = pixelLabel.at<int>( y, x );
-			int paletteIndex = paletteMap.at<int>( y, x );
-			superpixelColorHist[labelIndex][paletteIndex]++;
-		}
+const LabelAdjacency *KeyFrame::FindAdjacency( int label0, int label1 ) const {
+
+	if ( label0 > label1 ) swap( label0, label1 );
+	if ( label0 < 0 || label0 + 1 >= (int)adjacencyBegin.size() ) return NULL;
+
+	for ( int k = adjacencyBegin[label0]; k < adjacencyBegin[label0 + 1]; k++ ) {
+		if ( superpixelAdjacency[k].label1 == label1 ) return &superpixelAdjacency[k];
 	}
+	return NULL;
+
 }
 
 void KeyFrame::CalcSpatialContrast() {
@@ -240,7 +324,7 @@ void KeyFrame::CalcSpatialContrast() {
 
 	for ( int y = 0; y < rows; y++ ) {
 		for ( int x = 0; x < cols; x++ ) {
-			spatialContrastMap.at<float>( y, x ) = tmp[pixelLabel.at<int>( y, x )];
+			spatialContrastMap.at<float>( y, x ) = tmp[labelMap.At( y, x )];
 		}
 	}
 	cout << frameId << endl;
@@ -254,20 +338,14 @@ void KeyFrame::CalcTemporalContrast() {
 	superpixelTemporalContrast = vector<double>( superpixelNum, 0 );
 
 	if ( !opFlag ) {
-		for ( int y = 0; y < rows; y++ ) {
-			for ( int x = 0; x < cols; x++ ) {
-				int label = pixelLabel.at<int>( y, x );
-				superpixelTemporalContrast[label] += NormL2( backwardLocalMotionMap.at<Point2f>( y, x ) );
-			}
+		for ( int i = 0; i < superpixelNum; i++ ) {
+			superpixelTemporalContrast[i] += superpixelBackwardMotion[i];
 		}
 	}
 
 	if ( !edFlag ) {
-		for ( int y = 0; y < rows; y++ ) {
-			for ( int x = 0; x < cols; x++ ) {
-				int label = pixelLabel.at<int>( y, x );
-				superpixelTemporalContrast[label] += NormL2( forwardLocalMotionMap.at<Point2f>( y, x ) );
-			}
+		for ( int i = 0; i < superpixelNum; i++ ) {
+			superpixelTemporalContrast[i] += superpixelForwardMotion[i];
 		}
 	}
 
@@ -289,7 +367,7 @@ void KeyFrame::CalcTemporalContrast() {
 
 	for ( int y = 0; y < rows; y++ ) {
 		for ( int x = 0; x < cols; x++ ) {
-			int label = pixelLabel.at<int>( y, x );
+			int label = labelMap.At( y, x );
 			temporalContrastMap.at<float>( y, x ) = tmp[label];
 		}
 	}
@@ -315,34 +393,43 @@ void KeyFrame::CalcSaliencyMap() {
 
 	NormalizeVec( superpixelSaliency );
 
-	saliencyMap = Mat::zeros( size, CV_32FC1 );
-
-	for ( int y = 0; y < rows; y++ ) {
-		for ( int x = 0; x < cols; x++ ) {
-			int label = pixelLabel.at<int>( y, x );
-			saliencyMap.at<float>( y, x ) = superpixelSaliency[label];
-		}
-	}
 #ifdef DEBUG_SALIENCY_MAP
 	cout << frameId << endl;
-	imshow( "Saliency Map", saliencyMap );
+	imshow( "Saliency Map", GetSaliencyMap() );
 	waitKey( 0 );
 #endif
 }
 
-void KeyFrame::SumSuperpixelSaliency() {
+const Mat &KeyFrame::GetSaliencyMap() {
 
-	superpixelSaliency = vector<double>( superpixelNum, 0 );
+	if ( saliencyMap.empty() || saliencyMapSource != superpixelSaliency ) {
 
-	for ( int y = 0; y < rows; y++ ) {
-		for ( int x = 0; x < cols; x++ ) {
-			int label = pixelLabel.at<int>( y, x );
-			superpixelSaliency[label] += saliencyMap.at<float>( y, x );
+		saliencyMap = Mat( size, CV_32FC1 );
+		for ( int y = 0; y < rows; y++ ) {
+			float *saliencyRow = saliencyMap.ptr<float>( y );
+			for ( const LabelMap::Run *run = labelMap.RunBegin( y ); run != labelMap.RunEnd( y ); run++ ) {
+				fill( saliencyRow + run->x, saliencyRow + run->x + run->length, (float)superpixelSaliency[run->label] );
+			}
 		}
+		saliencyMapSource = superpixelSaliency;
+
 	}
 
+	return saliencyMap;
+
+}
+
+void KeyFrame::SumSuperpixelSaliency( const Mat &_pixelSaliencyMap ) {
+
+	LabelReducer reducer( labelMap, superpixelNum );
+	reducer.AddSaliency( _pixelSaliencyMap );
+
+	LabelStats stats;
+	reducer.Reduce( stats );
+
+	superpixelSaliency = stats.saliencySum;
 	for ( int i = 0; i < superpixelNum; i++ ) {
-		superpixelSaliency[i] /= superpixelCard[i];
+		superpixelSaliency[i] /= stats.card[i];
 	}
 
 	NormalizeVec( superpixelSaliency );
@@ -5,6 +5,7 @@
 #include <queue>
 #include "common.h"
 #include "slic.h"
+#include "LabelReducer.h"
 
 class KeyFrame {
 
@@ -17,6 +18,18 @@ private:
 	
 	Mat spatialContrastMap, temporalContrastMap;
 	vector<double> superpixelSpatialContrast, superpixelTemporalContrast;
+	vector<double> superpixelForwardMotion, superpixelBackwardMotion;
+
+	// Pixel view of superpixelSaliency, rasterized on demand.
+	Mat saliencyMap;
+	vector<double> saliencyMapSource;
+
+	// Adjacent superpixel pairs with their shared boundary, from ReduceSuperpixelStats.
+	// Entries with label0 == j start at adjacencyBegin[j].
+	vector<LabelAdjacency> superpixelAdjacency;
+	vector<int> adjacencyBegin;
+
+	void GenerateSuperpixel( SLIC &, SlicWorkspace & );
 
 	double CalcColorHistDiff( int, int );
 	double CalcSpatialDiff( int, int );
@@ -32,12 +45,14 @@ public:
 	} BOUND_LABEL;
 
 	Mat img, CIELabImg, grayImg;
-	Mat pixelLabel;
+	// Superpixel labels as 16 bit labels and row runs, the full width SLIC output is not kept.
+	LabelMap labelMap;
 	Mat forwardFlowMap, backwardFlowMap, forwardLocalMotionMap, backwardLocalMotionMap;
+	// Per pixel saliency from a backend, averaged into superpixelSaliency by ReduceSuperpixelStats.
+	Mat pixelSaliencyMap;
 
 	vector<int> superpixelBoundLabel;
 
-	Mat saliencyMap;
 	vector<double> superpixelSaliency;
 
 	int frameId, cols, rows, superpixelNum;
@@ -47,17 +62,33 @@ public:
 
 	vector<Point> superpixelCenter;
 
+	// Region adjacency graph sorted by label pair, rebuilt only with its index by ReduceSuperpixelStats.
+	const vector<LabelAdjacency> &GetAdjacency() const;
+	// Edge between two superpixels in either order, NULL when they do not touch.
+	const LabelAdjacency *FindAdjacency( int label0, int label1 ) const;
+
+	// Final SLIC centers, and for each superpixel the SLIC seed it grew from.
+	// Warm started keyframes inherit the seed order, so equal track ids mark
+	// the same region across keyframes of a shot.
+	SlicSeeds superpixelSeeds;
+	vector<int> superpixelTrackId;
+	// Whether the track ids continue those of the previous keyframe, after a warm start
+	// from it or within one supervoxel stack. A cold start only numbers its own seeds.
+	bool superpixelTracked;
+
 	KeyFrame( const Mat &, int );
 	void DrawImgWithContours( SLIC & );
-	void SegSuperpixel();
-	void MarkBoundLabel();
+	void SegSuperpixel( SlicWorkspace & );
+	void SegSuperpixel( const KeyFrame &, SlicWorkspace & );
+	void SetSupervoxelLabel( const int *, int );
 	void QuantizeColorSpace( const vector<Vec3f> &, const Mat & );
-	void CalcSuperpixelColorHist();
+	void ReduceSuperpixelStats();
 
 	void CalcSpatialContrast();
 	void CalcTemporalContrast();
 	void CalcSaliencyMap();
-	void SumSuperpixelSaliency();
+	const Mat &GetSaliencyMap();
+	void SumSuperpixelSaliency( const Mat & );
 
 	void FreeMemory();
 
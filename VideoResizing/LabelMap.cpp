@@ -0,0 +1,95 @@
+#include "LabelMap.h"
+
+class LabelMapBuildBody : public ParallelLoopBody {
+
+private:
+	const Mat &pixelLabel;
+	LabelMap &labelMap;
+	bool fillRuns;
+
+public:
+	LabelMapBuildBody( const Mat &_pixelLabel, LabelMap &_labelMap, bool _fillRuns ) :
+		pixelLabel( _pixelLabel ), labelMap( _labelMap ), fillRuns( _fillRuns ) {}
+
+	void operator()( const Range &range ) const {
+		int cols = pixelLabel.cols;
+		for ( int y = range.start; y < range.end; y++ ) {
+
+			const int *labelRow = pixelLabel.ptr<int>( y );
+
+			// First pass narrows the labels and counts the runs, second one stores them.
+			if ( !fillRuns ) {
+				ushort *denseRow = labelMap.dense.ptr<ushort>( y );
+				int runNum = 0;
+				for ( int x = 0; x < cols; x++ ) {
+					denseRow[x] = (ushort)labelRow[x];
+					if ( x == 0 || labelRow[x] != labelRow[x - 1] ) runNum++;
+				}
+				labelMap.rowRunSt[y + 1] = runNum;
+			} else {
+				LabelMap::Run *run = &labelMap.runs[labelMap.rowRunSt[y]] - 1;
+				for ( int x = 0; x < cols; x++ ) {
+					if ( x == 0 || labelRow[x] != labelRow[x - 1] ) {
+						run++;
+						run->x = (ushort)x;
+						run->length = 0;
+						run->label = (ushort)labelRow[x];
+					}
+					run->length++;
+				}
+			}
+
+		}
+	}
+
+};
+
+LabelMap::LabelMap() {
+
+	rows = 0;
+	cols = 0;
+
+}
+
+void LabelMap::Build( const Mat &pixelLabel ) {
+
+	// Labels, run starts and run lengths are all stored as ushort.
+	double minLabel, maxLabel;
+	CV_Assert( pixelLabel.type() == CV_32SC1 && pixelLabel.cols <= 65535 );
+	minMaxLoc( pixelLabel, &minLabel, &maxLabel );
+	CV_Assert( minLabel >= 0 && maxLabel <= 65535 );
+
+	rows = pixelLabel.rows;
+	cols = pixelLabel.cols;
+	dense.create( rows, cols, CV_16UC1 );
+	rowRunSt.assign( rows + 1, 0 );
+
+	parallel_for_( Range( 0, rows ), LabelMapBuildBody( pixelLabel, *this, false ) );
+	for ( int y = 0; y < rows; y++ ) {
+		rowRunSt[y + 1] += rowRunSt[y];
+	}
+
+	runs.resize( rowRunSt[rows] );
+	parallel_for_( Range( 0, rows ), LabelMapBuildBody( pixelLabel, *this, true ) );
+
+}
+
+bool LabelMap::empty() const {
+	return dense.empty();
+}
+
+const ushort *LabelMap::Row( int y ) const {
+	return dense.ptr<ushort>( y );
+}
+
+const LabelMap::Run *LabelMap::RunBegin( int y ) const {
+	return &runs[0] + rowRunSt[y];
+}
+
+const LabelMap::Run *LabelMap::RunEnd( int y ) const {
+	return &runs[0] + rowRunSt[y + 1];
+}
+
+int LabelMap::RunNum() const {
+	return runs.size();
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef LABELMAP_H
+#define LABELMAP_H
+
+#include "common.h"
+
+/*
+Superpixel label image kept as 16 bit labels plus per row runs of equal labels.
+Random access goes through the dense plane, scans walk the runs so a whole run
+costs one label lookup. Built once per keyframe from the CV_32SC1 SLIC output.
+*/
+class LabelMap {
+
+public:
+	struct Run {
+		ushort x, length, label;
+	};
+
+	int rows, cols;
+	Mat dense;
+
+	LabelMap();
+
+	void Build( const Mat &pixelLabel );
+	bool empty() const;
+
+	int At( int y, int x ) const {
+		return dense.ptr<ushort>( y )[x];
+	}
+
+	int At( const Point &p ) const {
+		return At( p.y, p.x );
+	}
+
+	const ushort *Row( int y ) const;
+
+	// Runs of row y, left to right and covering the whole row.
+	const Run *RunBegin( int y ) const;
+	const Run *RunEnd( int y ) const;
+	int RunNum() const;
+
+private:
+	vector<Run> runs;
+	vector<int> rowRunSt;
+
+	friend class LabelMapBuildBody;
+
+};
+
+#endif
\ No newline at end of file
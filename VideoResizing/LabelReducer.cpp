@@ -0,0 +1,372 @@
+#include "LabelReducer.h"
+
+class LabelReduceBody : public ParallelLoopBody {
+
+private:
+	const LabelReducer &reducer;
+	vector<LabelStats> &partials;
+	int rows;
+
+public:
+	LabelReduceBody( const LabelReducer &_reducer, vector<LabelStats> &_partials, int _rows ) :
+		reducer( _reducer ), partials( _partials ), rows( _rows ) {}
+
+	void operator()( const Range &range ) const {
+		for ( int stripe = range.start; stripe < range.end; stripe++ ) {
+			int rowSt = stripe * LABEL_REDUCE_STRIPE_ROWS;
+			int rowEd = min( rows, rowSt + LABEL_REDUCE_STRIPE_ROWS );
+			reducer.ReduceRows( rowSt, rowEd, partials[stripe] );
+		}
+	}
+
+};
+
+class LabelMergeBody : public ParallelLoopBody {
+
+private:
+	const LabelReducer &reducer;
+	const vector<LabelStats> &partials;
+	LabelStats &stats;
+
+public:
+	LabelMergeBody( const LabelReducer &_reducer, const vector<LabelStats> &_partials, LabelStats &_stats ) :
+		reducer( _reducer ), partials( _partials ), stats( _stats ) {}
+
+	void operator()( const Range &range ) const {
+		reducer.MergeLabels( range.start, range.end, partials, stats );
+	}
+
+};
+
+LabelReducer::LabelReducer( const LabelMap &_labelMap, int _labelNum ) : labelMap( _labelMap ) {
+
+	labelNum = _labelNum;
+	reducePosition = false;
+	reduceAdjacency = false;
+	paletteMap = NULL;
+	paletteSize = 0;
+	saliencyMap = NULL;
+
+}
+
+void LabelReducer::AddPosition() {
+	reducePosition = true;
+}
+
+void LabelReducer::AddAdjacency() {
+	reduceAdjacency = true;
+}
+
+void LabelReducer::AddColorHist( const Mat &_paletteMap, int _paletteSize ) {
+	paletteMap = &_paletteMap;
+	paletteSize = _paletteSize;
+}
+
+void LabelReducer::AddMotion( const Mat &motionMap ) {
+	motionMaps.push_back( &motionMap );
+}
+
+void LabelReducer::AddSaliency( const Mat &_saliencyMap ) {
+	saliencyMap = &_saliencyMap;
+}
+
+void LabelReducer::InitStats( LabelStats &stats ) const {
+
+	stats.card = vector<int>( labelNum, 0 );
+
+	if ( reducePosition ) {
+		stats.sumX = vector<int64>( labelNum, 0 );
+		stats.sumY = vector<int64>( labelNum, 0 );
+	} else {
+		stats.sumX.clear();
+		stats.sumY.clear();
+	}
+
+	if ( paletteMap ) {
+		stats.colorHist = vector< vector<int> >( labelNum, vector<int>( paletteSize, 0 ) );
+	} else {
+		stats.colorHist.clear();
+	}
+
+	stats.motionSum = vector< vector<double> >( motionMaps.size(), vector<double>( labelNum, 0 ) );
+
+	if ( saliencyMap ) {
+		stats.saliencySum = vector<double>( labelNum, 0 );
+	} else {
+		stats.saliencySum.clear();
+	}
+
+	stats.adjacency.clear();
+
+}
+
+void LabelReducer::ReduceRows( int rowSt, int rowEd, LabelStats &stats ) const {
+
+	int rows = labelMap.rows;
+
+	InitStats( stats );
+
+	int *card = &stats.card[0];
+
+	// Pairs met in this stripe; consecutive boundary runs mostly hit the same pair.
+	map< pair<int, int>, LabelAdjacency > adjacencyMap;
+	map< pair<int, int>, LabelAdjacency >::iterator lastPair = adjacencyMap.end();
+
+	for ( int y = rowSt; y < rowEd; y++ ) {
+
+		const LabelMap::Run *runSt = labelMap.RunBegin( y );
+		const LabelMap::Run *runEd = labelMap.RunEnd( y );
+
+		for ( const LabelMap::Run *run = runSt; run != runEd; run++ ) {
+			card[run->label] += run->length;
+		}
+
+		if ( reducePosition ) {
+			int64 *sumX = &stats.sumX[0];
+			int64 *sumY = &stats.sumY[0];
+			for ( const LabelMap::Run *run = runSt; run != runEd; run++ ) {
+				sumX[run->label] += (int64)run->length * run->x + (int64)run->length * (run->length - 1) / 2;
+				sumY[run->label] += (int64)run->length * y;
+			}
+		}
+
+		if ( paletteMap ) {
+			const int *paletteRow = paletteMap->ptr<int>( y );
+			for ( const LabelMap::Run *run = runSt; run != runEd; run++ ) {
+				int *colorHist = &stats.colorHist[run->label][0];
+				for ( int x = run->x; x < run->x + run->length; x++ ) {
+					colorHist[paletteRow[x]]++;
+				}
+			}
+		}
+
+		for ( size_t k = 0; k < motionMaps.size(); k++ ) {
+			const Point2f *motionRow = motionMaps[k]->ptr<Point2f>( y );
+			double *motionSum = &stats.motionSum[k][0];
+			for ( const LabelMap::Run *run = runSt; run != runEd; run++ ) {
+				double runSum = 0;
+				for ( int x = run->x; x < run->x + run->length; x++ ) {
+					runSum += NormL2( motionRow[x] );
+				}
+				motionSum[run->label] += runSum;
+			}
+		}
+
+		if ( saliencyMap ) {
+			const float *saliencyRow = saliencyMap->ptr<float>( y );
+			double *saliencySum = &stats.saliencySum[0];
+			for ( const LabelMap::Run *run = runSt; run != runEd; run++ ) {
+				double runSum = 0;
+				for ( int x = run->x; x < run->x + run->length; x++ ) {
+					runSum += saliencyRow[x];
+				}
+				saliencySum[run->label] += runSum;
+			}
+		}
+
+		if ( reduceAdjacency ) {
+
+			// Boundaries inside the row lie between consecutive runs.
+			for ( const LabelMap::Run *run = runSt; run + 1 != runEd; run++ ) {
+				int x = run->x + run->length - 1;
+				BoundSegment segment = { x, y, 1, false };
+				AccumulateBoundary( run->label, (run + 1)->label, segment, Point2d( x + 0.5, y ), adjacencyMap, lastPair );
+			}
+
+			// Boundaries to the row below, which may belong to the next stripe, from overlapping runs.
+			if ( y + 1 < rows ) {
+				const LabelMap::Run *lower = labelMap.RunBegin( y + 1 );
+				const LabelMap::Run *upper = runSt;
+				while ( upper != runEd ) {
+					int overlapSt = max( upper->x, lower->x );
+					int overlapEd = min( upper->x + upper->length, lower->x + lower->length );
+					if ( upper->label != lower->label ) {
+						int length = overlapEd - overlapSt;
+						double sumX = 0.5 * (overlapSt + overlapEd - 1) * length;
+						BoundSegment segment = { overlapSt, y, length, true };
+						AccumulateBoundary( upper->label, lower->label, segment, Point2d( sumX, (y + 0.5) * length ), adjacencyMap, lastPair );
+					}
+					if ( upper->x + upper->length == overlapEd ) upper++;
+					if ( lower->x + lower->length == overlapEd ) lower++;
+				}
+			}
+
+		}
+
+	}
+
+	for ( const auto &adjacency : adjacencyMap ) {
+		stats.adjacency.push_back( adjacency.second );
+	}
+
+}
+
+void LabelReducer::AccumulateBoundary( int label0, int label1, const BoundSegment &segment, const Point2d &boundSum,
+									   map< pair<int, int>, LabelAdjacency > &adjacencyMap,
+									   map< pair<int, int>, LabelAdjacency >::iterator &lastPair ) const {
+
+	pair<int, int> key( min( label0, label1 ), max( label0, label1 ) );
+	if ( lastPair == adjacencyMap.end() || lastPair->first != key ) {
+		lastPair = adjacencyMap.insert( make_pair( key, LabelAdjacency( key.first, key.second ) ) ).first;
+	}
+	lastPair->second.boundLength += segment.length;
+	lastPair->second.boundSum += boundSum;
+	// The crossing needs the centers, which only the position reduce gives.
+	if ( reducePosition ) lastPair->second.boundSegments.push_back( segment );
+
+}
+
+void LabelReducer::MergeLabels( int labelSt, int labelEd, const vector<LabelStats> &partials, LabelStats &stats ) const {
+
+	for ( const auto &partial : partials ) {
+		for ( int i = labelSt; i < labelEd; i++ ) {
+
+			stats.card[i] += partial.card[i];
+
+			if ( reducePosition ) {
+				stats.sumX[i] += partial.sumX[i];
+				stats.sumY[i] += partial.sumY[i];
+			}
+
+			if ( paletteMap ) {
+				for ( int c = 0; c < paletteSize; c++ ) {
+					stats.colorHist[i][c] += partial.colorHist[i][c];
+				}
+			}
+
+			for ( size_t k = 0; k < motionMaps.size(); k++ ) {
+				stats.motionSum[k][i] += partial.motionSum[k][i];
+			}
+
+			if ( saliencyMap ) {
+				stats.saliencySum[i] += partial.saliencySum[i];
+			}
+
+		}
+	}
+
+}
+
+void LabelReducer::MergeAdjacency( const vector<LabelStats> &partials, LabelStats &stats ) const {
+
+	// Stable sort keeps stripe order within a pair, so the sums do not depend on scheduling.
+	vector<LabelAdjacency> allAdjacency;
+	for ( const auto &partial : partials ) {
+		allAdjacency.insert( allAdjacency.end(), partial.adjacency.begin(), partial.adjacency.end() );
+	}
+	stable_sort( allAdjacency.begin(), allAdjacency.end() );
+
+	for ( const auto &adjacency : allAdjacency ) {
+		if ( stats.adjacency.empty() || stats.adjacency.back() < adjacency ) {
+			stats.adjacency.push_back( adjacency );
+		} else {
+			LabelAdjacency &merged = stats.adjacency.back();
+			merged.boundLength += adjacency.boundLength;
+			merged.boundSum += adjacency.boundSum;
+			merged.boundSegments.insert( merged.boundSegments.end(), adjacency.boundSegments.begin(), adjacency.boundSegments.end() );
+		}
+	}
+
+	for ( auto &adjacency : stats.adjacency ) {
+		adjacency.midPoint = SnapToBoundary( adjacency );
+		if ( reducePosition ) FindCrossPoint( stats, adjacency );
+		vector<BoundSegment>().swap( adjacency.boundSegments );
+	}
+
+}
+
+static double SqrDistToSegment( const Point2d &p, const Point2d &a, const Point2d &b ) {
+
+	Point2d u = b - a;
+	double len = u.dot( u );
+	double t = (len > 0) ? max( 0.0, min( 1.0, (p - a).dot( u ) / len ) ) : 0.0;
+	Point2d d = p - (a + t * u);
+	return d.dot( d );
+
+}
+
+void LabelReducer::FindCrossPoint( const LabelStats &stats, LabelAdjacency &adjacency ) const {
+
+	// Centers truncated as KeyFrame does, so the segment is the one between the control points.
+	int label0 = adjacency.label0, label1 = adjacency.label1;
+	Point2d c0( (int)(stats.sumX[label0] / stats.card[label0]), (int)(stats.sumY[label0] / stats.card[label0]) );
+	Point2d c1( (int)(stats.sumX[label1] / stats.card[label1]), (int)(stats.sumY[label1] / stats.card[label1]) );
+
+	double bestDist = INF;
+	for ( const auto &segment : adjacency.boundSegments ) {
+
+		// Cracks of the piece lie on one horizontal line, the distance to the center segment is convex along it.
+		double offsetX = segment.down ? 0 : 0.5;
+		double crackY = segment.down ? segment.y + 0.5 : segment.y;
+		double candidates[5] = { 0, segment.length - 1.0, c0.x - segment.x - offsetX, c1.x - segment.x - offsetX, -1 };
+		if ( c0.y != c1.y && (crackY - c0.y) * (crackY - c1.y) <= 0 ) {
+			candidates[4] = c0.x + (crackY - c0.y) / (c1.y - c0.y) * (c1.x - c0.x) - segment.x - offsetX;
+		}
+
+		for ( int k = 0; k < 5; k++ ) {
+			int t = max( 0, min( segment.length - 1, RoundToInt( candidates[k] ) ) );
+			double dist = SqrDistToSegment( Point2d( segment.x + t + offsetX, crackY ), c0, c1 );
+			if ( dist < bestDist ) {
+				bestDist = dist;
+				Point pixel( segment.x + t, segment.y );
+				Point neighbor = segment.down ? Point( pixel.x, pixel.y + 1 ) : Point( pixel.x + 1, pixel.y );
+				if ( labelMap.At( pixel ) != label0 ) swap( pixel, neighbor );
+				adjacency.crossPoint0 = pixel;
+				adjacency.crossPoint1 = neighbor;
+			}
+		}
+
+	}
+
+}
+
+Point LabelReducer::SnapToBoundary( const LabelAdjacency &adjacency ) const {
+
+	// The mean crack position of a curved boundary may lie off it; search rings around it.
+	int cols = labelMap.cols;
+	int rows = labelMap.rows;
+	Point center( RoundToInt( adjacency.boundSum.x / adjacency.boundLength ), RoundToInt( adjacency.boundSum.y / adjacency.boundLength ) );
+	RestrictInside( center, Size( cols, rows ) );
+
+	int maxRadius = max( cols, rows );
+	for ( int r = 0; r < maxRadius; r++ ) {
+		for ( int y = center.y - r; y <= center.y + r; y++ ) {
+			if ( y < 0 || y >= rows ) continue;
+			const ushort *labelRow = labelMap.Row( y );
+			// Whole row on the ring's top and bottom, only its two ends in between.
+			int dx = (y == center.y - r || y == center.y + r) ? 1 : max( 2 * r, 1 );
+			for ( int x = center.x - r; x <= center.x + r; x += dx ) {
+				if ( x < 0 || x >= cols ) continue;
+
+				int label = labelRow[x];
+				if ( label != adjacency.label0 && label != adjacency.label1 ) continue;
+				int other = (label == adjacency.label0) ? adjacency.label1 : adjacency.label0;
+
+				if ( (x > 0 && labelRow[x - 1] == other) || (x + 1 < cols && labelRow[x + 1] == other) ||
+					(y > 0 && labelMap.At( y - 1, x ) == other) || (y + 1 < rows && labelMap.At( y + 1, x ) == other) ) {
+					return Point( x, y );
+				}
+			}
+		}
+	}
+
+	return center;
+
+}
+
+void LabelReducer::Reduce( LabelStats &stats ) const {
+
+	int rows = labelMap.rows;
+	int stripeNum = (rows + LABEL_REDUCE_STRIPE_ROWS - 1) / LABEL_REDUCE_STRIPE_ROWS;
+
+	vector<LabelStats> partials( stripeNum );
+	parallel_for_( Range( 0, stripeNum ), LabelReduceBody( *this, partials, rows ) );
+
+	InitStats( stats );
+	parallel_for_( Range( 0, labelNum ), LabelMergeBody( *this, partials, stats ) );
+
+	if ( reduceAdjacency ) {
+		MergeAdjacency( partials, stats );
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef LABELREDUCER_H
+#define LABELREDUCER_H
+
+#include <map>
+#include "common.h"
+#include "LabelMap.h"
+
+// Straight piece of a boundary, pixels (x, y) to (x + length - 1, y) against the row below, or one pixel against its right neighbour.
+struct BoundSegment {
+	int x, y, length;
+	bool down;
+};
+
+// One edge of the region adjacency graph, label0 < label1.
+struct LabelAdjacency {
+
+	int label0, label1;
+	// Number of 4-neighbour pixel pairs across the shared boundary.
+	int boundLength;
+	// A boundary pixel near the middle of the shared boundary.
+	Point midPoint;
+	// The boundary pixel pair nearest to the segment between the two centers, on the label0 and label1 sides.
+	Point crossPoint0, crossPoint1;
+
+	// Sums of the crack midpoints and the boundary pieces while reducing.
+	Point2d boundSum;
+	vector<BoundSegment> boundSegments;
+
+	LabelAdjacency( int _label0, int _label1 ) :
+		label0( _label0 ), label1( _label1 ), boundLength( 0 ), midPoint( -1, -1 ),
+		crossPoint0( -1, -1 ), crossPoint1( -1, -1 ), boundSum( 0, 0 ) {}
+
+	bool operator < ( const LabelAdjacency &other ) const {
+		return label0 < other.label0 || (label0 == other.label0 && label1 < other.label1);
+	}
+
+};
+
+// Per superpixel aggregates gathered by LabelReducer, indexed by label.
+struct LabelStats {
+
+	vector<int> card;
+	vector<int64> sumX, sumY;
+	vector< vector<int> > colorHist;
+	vector< vector<double> > motionSum;
+	vector<double> saliencySum;
+	// Region adjacency graph sorted by label pair.
+	vector<LabelAdjacency> adjacency;
+
+};
+
+/*
+Computes every requested per superpixel aggregate in a single pass over the label runs.
+Rows are split into stripes that accumulate into their own partials, which are then
+merged label by label in stripe order so the result does not depend on scheduling.
+*/
+class LabelReducer {
+
+private:
+	const LabelMap &labelMap;
+	int labelNum;
+
+	bool reducePosition;
+	bool reduceAdjacency;
+	const Mat *paletteMap;
+	int paletteSize;
+	vector<const Mat *> motionMaps;
+	const Mat *saliencyMap;
+
+	void InitStats( LabelStats &stats ) const;
+	void ReduceRows( int rowSt, int rowEd, LabelStats &stats ) const;
+	void MergeLabels( int labelSt, int labelEd, const vector<LabelStats> &partials, LabelStats &stats ) const;
+	void MergeAdjacency( const vector<LabelStats> &partials, LabelStats &stats ) const;
+	void AccumulateBoundary( int label0, int label1, const BoundSegment &segment, const Point2d &boundSum,
+							 map< pair<int, int>, LabelAdjacency > &adjacencyMap,
+							 map< pair<int, int>, LabelAdjacency >::iterator &lastPair ) const;
+	Point SnapToBoundary( const LabelAdjacency &adjacency ) const;
+	void FindCrossPoint( const LabelStats &stats, LabelAdjacency &adjacency ) const;
+
+	friend class LabelReduceBody;
+	friend class LabelMergeBody;
+
+public:
+	LabelReducer( const LabelMap &_labelMap, int _labelNum );
+
+	// Cardinality is always reduced, everything else only when requested.
+	void AddPosition();
+	void AddColorHist( const Mat &_paletteMap, int _paletteSize );
+	void AddMotion( const Mat &motionMap );
+	void AddSaliency( const Mat &_saliencyMap );
+	void AddAdjacency();
+
+	void Reduce( LabelStats &stats ) const;
+
+};
+
+#endif
\ No newline at end of file
@@ -1,8 +1,8 @@
 #include "Render.h"
 
 Render::Render( const Deformation &deformation, 
-				vector<ControlPoint> &_controlPoints, 
-				vector<KeyFrame> &_keyFrames ) :controlPoints( _controlPoints ), keyFrames(_keyFrames) {
+				const ControlGraph &_controlGraph, 
+				vector<KeyFrame> &_keyFrames ) :controlGraph( _controlGraph ), keyFrames(_keyFrames) {
 	frameSize = deformation.frameSize;
 	deformedFrameSize = deformation.deformedFrameSize;
 	frameNum = deformation.frameNum;
@@ -176,16 +176,16 @@ void Render::CalcDeformedMaps() {
 	for ( int frameId = 0; frameId < frameNum; frameId++ ) {
 
 		controlPointSt = controlPointEd;
-		for ( ; controlPointEd < (int)controlPoints.size(); controlPointEd++ ) {
-			if ( controlPoints[controlPointEd].frameId != frameId ) break;
+		for ( ; controlPointEd < controlGraph.pointNum; controlPointEd++ ) {
+			if ( controlGraph.frameId[controlPointEd] != frameId ) break;
 		}
 
 		vector<Point> originPos, pos;
 		for ( int controlPointIndex = controlPointSt; controlPointIndex < controlPointEd; controlPointIndex++ ) {
-			ControlPoint &controlPoint = controlPoints[controlPointIndex];
-			if ( controlPoint.anchorType == ControlPoint::ANCHOR_BOUND || controlPoint.anchorType == ControlPoint::ANCHOR_CENTER ) {
-				originPos.push_back( controlPoint.originPos );
-				pos.push_back( controlPoint.pos );
+			int anchorType = controlGraph.anchorType[controlPointIndex];
+			if ( anchorType == ControlPoint::ANCHOR_BOUND || anchorType == ControlPoint::ANCHOR_CENTER ) {
+				originPos.push_back( controlGraph.originPos[controlPointIndex] );
+				pos.push_back( controlGraph.pos[controlPointIndex] );
 			}
 		}
 
@@ -256,7 +256,7 @@ void Render::RenderKeyFrames() {
 
 		RenderFrame( keyFrames[i].img, deformedMaps[i], deformedFrame );
 
-		imshow( "Saliency Map", keyFrames[i].saliencyMap );
+		imshow( "Saliency Map", keyFrames[i].GetSaliencyMap() );
 		imshow( "Origin Frame", keyFrames[i].img );
 		imshow( "Deformed Frame", deformedFrame );
 
@@ -270,4 +270,25 @@ void Render::RenderKeyFrames() {
 
 	}
 
+}
+
+void Render::RenderFrames( const vector<Mat> &frames, int shotSt, const string &videoName, const string &targetName ) {
+
+	printf( "Render frames.\n" );
+
+	int keyFrameIndex = 0;
+
+	for ( int i = 0; i < (int)frames.size(); i++ ) {
+
+		// Frames after the last key frame keep its map.
+		while ( keyFrameIndex < frameNum - 1 && keyFrames[keyFrameIndex].frameId < shotSt + i ) {
+			keyFrameIndex++;
+		}
+
+		Mat deformedFrame;
+		RenderFrame( frames[i], deformedMaps[keyFrameIndex], deformedFrame );
+		WriteDeformedImg( shotSt + i, deformedFrame, videoName, targetName );
+
+	}
+
 }
\ No newline at end of file
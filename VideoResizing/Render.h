@@ -4,6 +4,7 @@
 #include "common.h"
 #include "KeyFrame.h"
 #include "ControlPoint.h"
+#include "ControlGraph.h"
 #include "Deformation.h"
 
 struct TypeA {
@@ -13,7 +14,7 @@ struct TypeA {
 class Render {
 
 private:
-	vector<ControlPoint> &controlPoints;
+	const ControlGraph &controlGraph;
 	vector<KeyFrame> &keyFrames;
 
 	Mat cpOriginMat, cpDeformedMat, pixelMat;
@@ -33,10 +34,12 @@ private:
 	Mat CalcDeformedMap();
 
 public:
-	Render( const Deformation &deformation, vector<ControlPoint> &controlPoints, vector<KeyFrame> &keyFrames );
+	Render( const Deformation &deformation, const ControlGraph &controlGraph, vector<KeyFrame> &keyFrames );
 	void CalcDeformedMaps();
 	void RenderFrame( const Mat &img, const Mat &deformedMap, Mat &deformedImg );
 	void RenderKeyFrames();
+	// Every frame of the shot starting at shotSt, warped by the map of the next key frame.
+	void RenderFrames( const vector<Mat> &frames, int shotSt, const string &videoName, const string &targetName );
 
 };
 
@@ -0,0 +1,41 @@
+#include "SaliencyProvider.h"
+
+string ContrastSaliencyProvider::GetName() const {
+	return "contrast";
+}
+
+void ContrastSaliencyProvider::CalcSaliency( vector<KeyFrame> &frames ) {
+
+	// Palette and motion maps come first so CalcSuperpixel reduces them with the labels.
+	QuantizeFrames( frames );
+	CalcMotionMap( frames );
+	CalcSuperpixel( frames );
+	// SegEdges( frames );
+
+	CalcSaliencyMap( frames );
+	SmoothSaliencyMap( frames );
+
+}
+
+string SpectralResidualSaliencyProvider::GetName() const {
+	return "spectral";
+}
+
+void SpectralResidualSaliencyProvider::CalcSaliency( vector<KeyFrame> &frames ) {
+
+	CalcSpectralResidualSaliency( frames );
+	CalcSuperpixel( frames );
+
+	SmoothSaliencyMap( frames );
+
+}
+
+Ptr<SaliencyProvider> CreateSaliencyProvider( const string &saliencyType ) {
+
+	if ( saliencyType == "spectral" ) {
+		return Ptr<SaliencyProvider>( new SpectralResidualSaliencyProvider() );
+	}
+
+	return Ptr<SaliencyProvider>( new ContrastSaliencyProvider() );
+
+}
\ No newline at end of file
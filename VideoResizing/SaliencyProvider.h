@@ -0,0 +1,43 @@
+#ifndef SALIENCYPROVIDER_H
+#define SALIENCYPROVIDER_H
+
+#include "common.h"
+#include "KeyFrame.h"
+#include "pretreat.h"
+#include "saliency.h"
+
+/*
+A saliency backend segments every keyframe of a shot into superpixels and fills
+what Deformation consumes: labelMap, superpixelCenter, superpixelBoundLabel,
+forwardFlowMap and superpixelSaliency.
+*/
+class SaliencyProvider {
+
+public:
+	virtual ~SaliencyProvider() {}
+	virtual string GetName() const = 0;
+	virtual void CalcSaliency( vector<KeyFrame> &frames ) = 0;
+
+};
+
+// Palette quantization, superpixel color contrast and full resolution motion contrast.
+class ContrastSaliencyProvider : public SaliencyProvider {
+
+public:
+	string GetName() const;
+	void CalcSaliency( vector<KeyFrame> &frames );
+
+};
+
+// Spectral residual on a small proxy image with downscaled optical flow, for tight latency budgets.
+class SpectralResidualSaliencyProvider : public SaliencyProvider {
+
+public:
+	string GetName() const;
+	void CalcSaliency( vector<KeyFrame> &frames );
+
+};
+
+Ptr<SaliencyProvider> CreateSaliencyProvider( const string &saliencyType );
+
+#endif
\ No newline at end of file
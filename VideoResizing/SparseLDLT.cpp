@@ -0,0 +1,251 @@
+#include "SparseLDLT.h"
+
+SparseLDLT::SparseLDLT() {
+
+	n = 0;
+
+}
+
+void SparseLDLT::OrderMinimumDegree( const SparseMatrix &A ) {
+
+	// Quotient graph: eliminated pivots become elements holding the variables they connect,
+	// a variable keeps its remaining variable neighbours and the elements it belongs to.
+	vector< vector<int> > varAdj( n ), elemAdj( n ), elemVars( n );
+	vector<int> degree( n );
+	for ( int i = 0; i < n; i++ ) {
+		for ( int k = A.rowPtr[i]; k < A.rowPtr[i + 1]; k++ ) {
+			if ( A.colIndex[k] != i ) varAdj[i].push_back( A.colIndex[k] );
+		}
+		sort( varAdj[i].begin(), varAdj[i].end() );
+		varAdj[i].erase( unique( varAdj[i].begin(), varAdj[i].end() ), varAdj[i].end() );
+		degree[i] = varAdj[i].size();
+	}
+
+	enum { VARIABLE, ELEMENT, ABSORBED };
+	vector<char> state( n, VARIABLE );
+	vector<int> mark( n, -1 ), elemStamp( n, -1 ), elemOuter( n, 0 );
+
+	// Variables bucketed by approximate degree in doubly linked lists, least degree first.
+	vector<int> bucketHead( n + 1, -1 ), bucketNext( n, -1 ), bucketPrev( n, -1 );
+	int minDegree = n;
+	auto insertBucket = [&]( int i ) {
+		int d = degree[i];
+		bucketPrev[i] = -1;
+		bucketNext[i] = bucketHead[d];
+		if ( bucketHead[d] >= 0 ) bucketPrev[bucketHead[d]] = i;
+		bucketHead[d] = i;
+		minDegree = min( minDegree, d );
+	};
+	auto removeBucket = [&]( int i ) {
+		if ( bucketPrev[i] >= 0 ) bucketNext[bucketPrev[i]] = bucketNext[i];
+		else bucketHead[degree[i]] = bucketNext[i];
+		if ( bucketNext[i] >= 0 ) bucketPrev[bucketNext[i]] = bucketPrev[i];
+	};
+	for ( int i = n - 1; i >= 0; i-- ) {
+		insertBucket( i );
+	}
+
+	perm.clear();
+	perm.reserve( n );
+
+	for ( int k = 0; k < n; k++ ) {
+
+		while ( bucketHead[minDegree] < 0 ) minDegree++;
+		int p = bucketHead[minDegree];
+		removeBucket( p );
+		perm.push_back( p );
+
+		// Variables of the new element p, absorbing the elements p belonged to.
+		vector<int> &Lp = elemVars[p];
+		Lp.clear();
+		mark[p] = k;
+		for ( int i : varAdj[p] ) {
+			if ( state[i] == VARIABLE && mark[i] != k ) {
+				mark[i] = k;
+				Lp.push_back( i );
+			}
+		}
+		for ( int e : elemAdj[p] ) {
+			if ( state[e] != ELEMENT ) continue;
+			for ( int i : elemVars[e] ) {
+				if ( state[i] == VARIABLE && mark[i] != k ) {
+					mark[i] = k;
+					Lp.push_back( i );
+				}
+			}
+			state[e] = ABSORBED;
+			vector<int>().swap( elemVars[e] );
+		}
+		state[p] = ELEMENT;
+		vector<int>().swap( varAdj[p] );
+		vector<int>().swap( elemAdj[p] );
+
+		// |Le \ Lp| for the other elements next to Lp. Eliminating a variable absorbs every
+		// element holding it, so the live elements only hold variables.
+		for ( int i : Lp ) {
+			for ( int e : elemAdj[i] ) {
+				if ( state[e] != ELEMENT ) continue;
+				if ( elemStamp[e] != k ) {
+					elemStamp[e] = k;
+					elemOuter[e] = elemVars[e].size();
+				}
+				elemOuter[e]--;
+			}
+		}
+
+		// Approximate external degree as in AMD, bounded by the previous degree plus |Lp|.
+		int lpSize = Lp.size();
+		for ( int i : Lp ) {
+
+			removeBucket( i );
+
+			int outerSum = 0;
+			vector<int> &Ei = elemAdj[i];
+			Ei.erase( remove_if( Ei.begin(), Ei.end(), [&]( int e ) {
+				return state[e] != ELEMENT;
+			} ), Ei.end() );
+			for ( int e : Ei ) outerSum += elemOuter[e];
+			Ei.push_back( p );
+
+			// Neighbours in Lp are reached through p now.
+			vector<int> &Ai = varAdj[i];
+			Ai.erase( remove_if( Ai.begin(), Ai.end(), [&]( int j ) {
+				return state[j] != VARIABLE || mark[j] == k;
+			} ), Ai.end() );
+
+			int d = (int)Ai.size() + lpSize - 1 + outerSum;
+			d = min( d, degree[i] + lpSize - 1 );
+			d = min( d, n - k - 2 );
+			degree[i] = max( d, 0 );
+			insertBucket( i );
+
+		}
+
+	}
+
+	permInv.resize( n );
+	for ( int k = 0; k < n; k++ ) {
+		permInv[perm[k]] = k;
+	}
+
+}
+
+void SparseLDLT::Analyze( const SparseMatrix &A ) {
+
+	n = A.rows;
+	OrderMinimumDegree( A );
+
+	// Elimination tree and column counts of L for P A P^T, upper part of every column.
+	parent.assign( n, -1 );
+	colCount.assign( n, 0 );
+	vector<int> flag( n, -1 );
+
+	for ( int k = 0; k < n; k++ ) {
+		flag[k] = k;
+		int col = perm[k];
+		for ( int p = A.rowPtr[col]; p < A.rowPtr[col + 1]; p++ ) {
+			int i = permInv[A.colIndex[p]];
+			if ( i >= k ) continue;
+			for ( ; flag[i] != k; i = parent[i] ) {
+				if ( parent[i] == -1 ) parent[i] = k;
+				colCount[i]++;
+				flag[i] = k;
+			}
+		}
+	}
+
+	Lp.assign( n + 1, 0 );
+	for ( int k = 0; k < n; k++ ) {
+		Lp[k + 1] = Lp[k] + colCount[k];
+	}
+	Li.resize( Lp[n] );
+	Lx.resize( Lp[n] );
+	D.resize( n );
+
+}
+
+bool SparseLDLT::Factorize( const SparseMatrix &A ) {
+
+	vector<double> Y( n, 0 );
+	vector<int> pattern( n ), flag( n ), Lnz( n, 0 );
+
+	for ( int k = 0; k < n; k++ ) {
+
+		// Non-zero pattern of row k of L from the elimination tree, scatter column k into Y.
+		Y[k] = 0;
+		int top = n;
+		flag[k] = k;
+		int col = perm[k];
+		for ( int p = A.rowPtr[col]; p < A.rowPtr[col + 1]; p++ ) {
+			int i = permInv[A.colIndex[p]];
+			if ( i > k ) continue;
+			Y[i] += A.values[p];
+			int len;
+			for ( len = 0; flag[i] != k; i = parent[i] ) {
+				pattern[len++] = i;
+				flag[i] = k;
+			}
+			while ( len > 0 ) pattern[--top] = pattern[--len];
+		}
+
+		// Sparse triangular solve for row k of L and the pivot D[k].
+		D[k] = Y[k];
+		Y[k] = 0;
+		for ( ; top < n; top++ ) {
+			int i = pattern[top];
+			double yi = Y[i];
+			Y[i] = 0;
+			int pEnd = Lp[i] + Lnz[i];
+			for ( int p = Lp[i]; p < pEnd; p++ ) {
+				Y[Li[p]] -= Lx[p] * yi;
+			}
+			double lki = yi / D[i];
+			D[k] -= lki * yi;
+			Li[pEnd] = k;
+			Lx[pEnd] = lki;
+			Lnz[i]++;
+		}
+
+		if ( abs( D[k] ) < VERY_SMALL * VERY_SMALL ) return false;
+
+	}
+
+	return true;
+
+}
+
+void SparseLDLT::Solve( const vector<double> &b, vector<double> &x ) const {
+
+	vector<double> y( n );
+	for ( int k = 0; k < n; k++ ) {
+		y[k] = b[perm[k]];
+	}
+
+	for ( int j = 0; j < n; j++ ) {
+		for ( int p = Lp[j]; p < Lp[j + 1]; p++ ) {
+			y[Li[p]] -= Lx[p] * y[j];
+		}
+	}
+	for ( int j = 0; j < n; j++ ) {
+		y[j] /= D[j];
+	}
+	for ( int j = n - 1; j >= 0; j-- ) {
+		for ( int p = Lp[j]; p < Lp[j + 1]; p++ ) {
+			y[j] -= Lx[p] * y[Li[p]];
+		}
+	}
+
+	x.resize( n );
+	for ( int k = 0; k < n; k++ ) {
+		x[perm[k]] = y[k];
+	}
+
+}
+
+bool SparseLDLT::Analyzed() const {
+	return !Lp.empty();
+}
+
+int SparseLDLT::FactorNonZeroNum() const {
+	return Lp.empty() ? 0 : Lp[n];
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef SPARSELDLT_H
+#define SPARSELDLT_H
+
+#include "common.h"
+#include "SparseMatrix.h"
+
+/*
+Sparse LDL^T factorization of a symmetric matrix, after an up-looking LDL. Analyze
+orders the rows by approximate minimum degree on the quotient graph, without the
+supervariable detection of the full AMD, and computes the elimination tree and
+column counts of L, which only depend on the non-zero pattern. Factorize fills in L and D for the values and can be repeated
+for new values with the same pattern. FactorNonZeroNum reports the fill of L.
+*/
+class SparseLDLT {
+
+private:
+	int n;
+	vector<int> perm, permInv;
+	vector<int> parent, colCount;
+	vector<int> Lp, Li;
+	vector<double> Lx, D;
+
+	void OrderMinimumDegree( const SparseMatrix &A );
+
+public:
+	SparseLDLT();
+
+	void Analyze( const SparseMatrix &A );
+	// False on a zero pivot, the matrix is then singular for this ordering.
+	bool Factorize( const SparseMatrix &A );
+	void Solve( const vector<double> &b, vector<double> &x ) const;
+
+	bool Analyzed() const;
+	int FactorNonZeroNum() const;
+
+};
+
+#endif
\ No newline at end of file
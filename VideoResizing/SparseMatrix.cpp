@@ -0,0 +1,215 @@
+#include "SparseMatrix.h"
+
+SparseMatrix::SparseMatrix() {
+
+	rows = 0;
+	cols = 0;
+
+}
+
+SparseMatrix::SparseMatrix( int _rows, int _cols ) {
+
+	rows = _rows;
+	cols = _cols;
+
+}
+
+void SparseMatrix::Add( int row, int col, double value ) {
+
+	Triplet triplet;
+	triplet.row = row;
+	triplet.col = col;
+	triplet.value = value;
+	triplets.push_back( triplet );
+
+}
+
+void SparseMatrix::Compress() {
+
+	// Entries already compressed go first, so Add and Compress may alternate.
+	if ( !rowPtr.empty() ) {
+		vector<Triplet> compressed( values.size() );
+		for ( int i = 0; i < rows; i++ ) {
+			for ( int k = rowPtr[i]; k < rowPtr[i + 1]; k++ ) {
+				compressed[k].row = i;
+				compressed[k].col = colIndex[k];
+				compressed[k].value = values[k];
+			}
+		}
+		triplets.insert( triplets.begin(), compressed.begin(), compressed.end() );
+	}
+
+	// Counting sort by row keeps the insertion order inside each row.
+	vector<int> rowCount( rows + 1, 0 );
+	for ( const auto &triplet : triplets ) {
+		rowCount[triplet.row + 1]++;
+	}
+	for ( int i = 0; i < rows; i++ ) {
+		rowCount[i + 1] += rowCount[i];
+	}
+
+	vector<int> order( triplets.size() );
+	vector<int> rowFill( rowCount.begin(), rowCount.end() - 1 );
+	for ( size_t k = 0; k < triplets.size(); k++ ) {
+		order[rowFill[triplets[k].row]++] = k;
+	}
+
+	rowPtr.assign( rows + 1, 0 );
+	colIndex.clear();
+	values.clear();
+
+	for ( int i = 0; i < rows; i++ ) {
+
+		vector<int> rowOrder( order.begin() + rowCount[i], order.begin() + rowCount[i + 1] );
+		stable_sort( rowOrder.begin(), rowOrder.end(), [&]( int a, int b ) {
+			return triplets[a].col < triplets[b].col;
+		} );
+
+		for ( size_t k = 0; k < rowOrder.size(); k++ ) {
+			const Triplet &triplet = triplets[rowOrder[k]];
+			if ( k > 0 && colIndex.back() == triplet.col ) {
+				values.back() += triplet.value;
+			} else {
+				colIndex.push_back( triplet.col );
+				values.push_back( triplet.value );
+			}
+		}
+		rowPtr[i + 1] = colIndex.size();
+
+	}
+
+	triplets.clear();
+
+}
+
+int SparseMatrix::NonZeroNum() const {
+	return values.size();
+}
+
+double SparseMatrix::At( int row, int col ) const {
+
+	vector<int>::const_iterator colSt = colIndex.begin() + rowPtr[row];
+	vector<int>::const_iterator colEd = colIndex.begin() + rowPtr[row + 1];
+	vector<int>::const_iterator colPos = lower_bound( colSt, colEd, col );
+	if ( colPos != colEd && *colPos == col ) {
+		return values[colPos - colIndex.begin()];
+	} else {
+		return 0;
+	}
+
+}
+
+void SparseMatrix::Multiply( const vector<double> &x, vector<double> &y ) const {
+
+	y.assign( rows, 0 );
+	for ( int i = 0; i < rows; i++ ) {
+		double sum = 0;
+		for ( int k = rowPtr[i]; k < rowPtr[i + 1]; k++ ) {
+			sum += values[k] * x[colIndex[k]];
+		}
+		y[i] = sum;
+	}
+
+}
+
+void SparseMatrix::MultiplyTranspose( const vector<double> &x, vector<double> &y ) const {
+
+	y.assign( cols, 0 );
+	for ( int i = 0; i < rows; i++ ) {
+		for ( int k = rowPtr[i]; k < rowPtr[i + 1]; k++ ) {
+			y[colIndex[k]] += values[k] * x[i];
+		}
+	}
+
+}
+
+bool SparseMatrix::IsSymmetric( double tolerance ) const {
+
+	if ( rows != cols ) return false;
+
+	for ( int i = 0; i < rows; i++ ) {
+		for ( int k = rowPtr[i]; k < rowPtr[i + 1]; k++ ) {
+			double mirror = At( colIndex[k], i );
+			if ( abs( values[k] - mirror ) > tolerance * max( 1.0, abs( values[k] ) ) ) return false;
+		}
+	}
+	return true;
+
+}
+
+SparseMatrix SparseMatrix::NormalMatrix() const {
+
+	// Every row of A adds the outer product of its entries.
+	SparseMatrix normal( cols, cols );
+	for ( int i = 0; i < rows; i++ ) {
+		for ( int k0 = rowPtr[i]; k0 < rowPtr[i + 1]; k0++ ) {
+			for ( int k1 = rowPtr[i]; k1 < rowPtr[i + 1]; k1++ ) {
+				normal.Add( colIndex[k0], colIndex[k1], values[k0] * values[k1] );
+			}
+		}
+	}
+	normal.Compress();
+	return normal;
+
+}
+
+int SparseMatrix::ConnectedComponents( vector<int> &component ) const {
+
+	component.assign( rows, -1 );
+	int componentNum = 0;
+	vector<int> stack;
+
+	for ( int start = 0; start < rows; start++ ) {
+		if ( component[start] != -1 ) continue;
+		component[start] = componentNum;
+		stack.push_back( start );
+		while ( !stack.empty() ) {
+			int i = stack.back();
+			stack.pop_back();
+			for ( int k = rowPtr[i]; k < rowPtr[i + 1]; k++ ) {
+				int j = colIndex[k];
+				if ( component[j] == -1 ) {
+					component[j] = componentNum;
+					stack.push_back( j );
+				}
+			}
+		}
+		componentNum++;
+	}
+
+	return componentNum;
+
+}
+
+SparseMatrix SparseMatrix::SubMatrix( const vector<int> &indices ) const {
+
+	// Rows and columns in indices, renumbered in that order.
+	vector<int> localIndex( cols, -1 );
+	for ( size_t i = 0; i < indices.size(); i++ ) {
+		localIndex[indices[i]] = i;
+	}
+
+	SparseMatrix sub( indices.size(), indices.size() );
+	for ( size_t i = 0; i < indices.size(); i++ ) {
+		int row = indices[i];
+		for ( int k = rowPtr[row]; k < rowPtr[row + 1]; k++ ) {
+			int col = localIndex[colIndex[k]];
+			if ( col != -1 ) sub.Add( i, col, values[k] );
+		}
+	}
+	sub.Compress();
+	return sub;
+
+}
+
+Mat SparseMatrix::ToDense() const {
+
+	Mat dense( rows, cols, CV_32FC1, Scalar( 0 ) );
+	for ( int i = 0; i < rows; i++ ) {
+		for ( int k = rowPtr[i]; k < rowPtr[i + 1]; k++ ) {
+			dense.at<float>( i, colIndex[k] ) = (float)values[k];
+		}
+	}
+	return dense;
+
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef SPARSEMATRIX_H
+#define SPARSEMATRIX_H
+
+#include "common.h"
+
+/*
+Sparse matrix for the deformation energy system. Constraint builders Add entries
+as triplets in any order, Compress then sorts them into compressed sparse rows
+and sums duplicates in insertion order, so memory grows with the entries only.
+*/
+class SparseMatrix {
+
+private:
+	struct Triplet {
+		int row, col;
+		double value;
+	};
+
+	vector<Triplet> triplets;
+
+public:
+	int rows, cols;
+
+	// Compressed rows, valid after Compress.
+	vector<int> rowPtr, colIndex;
+	vector<double> values;
+
+	SparseMatrix();
+	SparseMatrix( int _rows, int _cols );
+
+	void Add( int row, int col, double value );
+	void Compress();
+
+	int NonZeroNum() const;
+	double At( int row, int col ) const;
+	void Multiply( const vector<double> &x, vector<double> &y ) const;
+	void MultiplyTranspose( const vector<double> &x, vector<double> &y ) const;
+	bool IsSymmetric( double tolerance ) const;
+	// A^T A, for systems that are not symmetric.
+	SparseMatrix NormalMatrix() const;
+	// Components of the non-zero pattern seen as a graph, numbered by first row.
+	int ConnectedComponents( vector<int> &component ) const;
+	SparseMatrix SubMatrix( const vector<int> &indices ) const;
+	Mat ToDense() const;
+
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "SparsePCG.h"
+
+SparsePCG::SparsePCG() {
+
+	preconditioner = PRECOND_IC0;
+	tolerance = 1e-6;
+	maxIterations = 1000;
+	iterations = 0;
+	residual = 0;
+	useIC0 = false;
+	useBlocks = false;
+	preparedMat = NULL;
+	preparedNonZeros = 0;
+
+}
+
+void SparsePCG::SetPreconditioner( int _preconditioner ) {
+	preconditioner = _preconditioner;
+	preparedMat = NULL;
+}
+
+void SparsePCG::SetTolerance( double _tolerance ) {
+	tolerance = _tolerance;
+}
+
+void SparsePCG::SetMaxIterations( int _maxIterations ) {
+	maxIterations = _maxIterations;
+}
+
+void SparsePCG::SetBlocks( const vector<int> &_blockOfRow ) {
+	blockOfRow = _blockOfRow;
+	preparedMat = NULL;
+}
+
+bool SparsePCG::BuildBlocks( const SparseMatrix &A ) {
+
+	if ( (int)blockOfRow.size() != A.rows ) return false;
+
+	int blockNum = 0;
+	for ( int i = 0; i < A.rows; i++ ) {
+		blockNum = max( blockNum, blockOfRow[i] + 1 );
+	}
+	blockRows.assign( blockNum, vector<int>() );
+	for ( int i = 0; i < A.rows; i++ ) {
+		blockRows[blockOfRow[i]].push_back( i );
+	}
+
+	blockFactors.assign( blockNum, SparseLDLT() );
+	for ( int k = 0; k < blockNum; k++ ) {
+		if ( blockRows[k].empty() ) continue;
+		SparseMatrix blockA = A.SubMatrix( blockRows[k] );
+		blockFactors[k].Analyze( blockA );
+		if ( !blockFactors[k].Factorize( blockA ) ) return false;
+	}
+
+	return true;
+
+}
+
+bool SparsePCG::BuildIC0( const SparseMatrix &A ) {
+
+	int n = A.rows;
+
+	// Lower triangle of A, columns stay sorted within every row.
+	Lp.assign( n + 1, 0 );
+	Lj.clear();
+	Lx.clear();
+	for ( int i = 0; i < n; i++ ) {
+		for ( int k = A.rowPtr[i]; k < A.rowPtr[i + 1] && A.colIndex[k] <= i; k++ ) {
+			Lj.push_back( A.colIndex[k] );
+			Lx.push_back( A.values[k] );
+		}
+		Lp[i + 1] = Lj.size();
+		if ( Lj.empty() || Lj.back() != i ) return false;
+	}
+
+	// L(i,k) = (A(i,k) - sum_j<k L(i,j) L(k,j)) / L(k,k) on the pattern of A only.
+	for ( int i = 0; i < n; i++ ) {
+		for ( int p = Lp[i]; p < Lp[i + 1]; p++ ) {
+			int k = Lj[p];
+			double sum = Lx[p];
+			int pi = Lp[i], pk = Lp[k];
+			while ( pi < p && pk < Lp[k + 1] - 1 ) {
+				if ( Lj[pi] == Lj[pk] ) sum -= Lx[pi++] * Lx[pk++];
+				else if ( Lj[pi] < Lj[pk] ) pi++;
+				else pk++;
+			}
+			if ( k < i ) {
+				Lx[p] = sum / Lx[Lp[k + 1] - 1];
+			} else {
+				if ( sum <= 0 ) return false;
+				Lx[p] = sqrt( sum );
+			}
+		}
+	}
+
+	return true;
+
+}
+
+void SparsePCG::ApplyPreconditioner( const vector<double> &r, vector<double> &z ) const {
+
+	int n = r.size();
+
+	if ( useBlocks ) {
+		vector<double> blockR, blockZ;
+		for ( size_t k = 0; k < blockRows.size(); k++ ) {
+			const vector<int> &rows = blockRows[k];
+			blockR.resize( rows.size() );
+			for ( size_t i = 0; i < rows.size(); i++ ) blockR[i] = r[rows[i]];
+			blockFactors[k].Solve( blockR, blockZ );
+			for ( size_t i = 0; i < rows.size(); i++ ) z[rows[i]] = blockZ[i];
+		}
+		return;
+	}
+
+	if ( !useIC0 ) {
+		for ( int i = 0; i < n; i++ ) z[i] = r[i] * invDiag[i];
+		return;
+	}
+
+	// L y = r, then L^T z = y.
+	for ( int i = 0; i < n; i++ ) {
+		double sum = r[i];
+		for ( int p = Lp[i]; p < Lp[i + 1] - 1; p++ ) {
+			sum -= Lx[p] * z[Lj[p]];
+		}
+		z[i] = sum / Lx[Lp[i + 1] - 1];
+	}
+	for ( int i = n - 1; i >= 0; i-- ) {
+		z[i] /= Lx[Lp[i + 1] - 1];
+		for ( int p = Lp[i]; p < Lp[i + 1] - 1; p++ ) {
+			z[Lj[p]] -= Lx[p] * z[i];
+		}
+	}
+
+}
+
+void SparsePCG::Prepare( const SparseMatrix &A ) {
+
+	int n = A.rows;
+
+	useBlocks = (preconditioner == PRECOND_BLOCK_JACOBI) && BuildBlocks( A );
+	useIC0 = !useBlocks && (preconditioner == PRECOND_IC0) && BuildIC0( A );
+	if ( !useBlocks && !useIC0 ) {
+		invDiag.assign( n, 1 );
+		for ( int i = 0; i < n; i++ ) {
+			double diag = A.At( i, i );
+			if ( abs( diag ) > VERY_SMALL ) invDiag[i] = 1 / diag;
+		}
+	}
+	preparedMat = &A;
+	preparedNonZeros = A.NonZeroNum();
+
+}
+
+bool SparsePCG::Solve( const SparseMatrix &A, const vector<double> &b, vector<double> &x ) {
+
+	int n = A.rows;
+	x.resize( n, 0 );
+
+	CV_Assert( preparedMat == &A && preparedNonZeros == A.NonZeroNum() );
+
+	double normB = 0;
+	for ( int i = 0; i < n; i++ ) normB += sqr( b[i] );
+	normB = max( sqrt( normB ), VERY_SMALL );
+
+	vector<double> r, z( n ), p( n ), Ap;
+	A.Multiply( x, r );
+	for ( int i = 0; i < n; i++ ) r[i] = b[i] - r[i];
+
+	ApplyPreconditioner( r, z );
+	p = z;
+	double rz = 0;
+	for ( int i = 0; i < n; i++ ) rz += r[i] * z[i];
+
+	iterations = 0;
+	double normR = 0;
+	for ( int i = 0; i < n; i++ ) normR += sqr( r[i] );
+	residual = sqrt( normR ) / normB;
+
+	while ( residual > tolerance && iterations < maxIterations ) {
+
+		A.Multiply( p, Ap );
+		double pAp = 0;
+		for ( int i = 0; i < n; i++ ) pAp += p[i] * Ap[i];
+		if ( pAp <= 0 ) break;
+
+		double alpha = rz / pAp;
+		normR = 0;
+		for ( int i = 0; i < n; i++ ) {
+			x[i] += alpha * p[i];
+			r[i] -= alpha * Ap[i];
+			normR += sqr( r[i] );
+		}
+		iterations++;
+		residual = sqrt( normR ) / normB;
+		if ( residual <= tolerance ) break;
+
+		ApplyPreconditioner( r, z );
+		double rzNew = 0;
+		for ( int i = 0; i < n; i++ ) rzNew += r[i] * z[i];
+		double beta = rzNew / rz;
+		rz = rzNew;
+		for ( int i = 0; i < n; i++ ) p[i] = z[i] + beta * p[i];
+
+	}
+
+	return residual <= tolerance;
+
+}
+
+int SparsePCG::GetIterations() const {
+	return iterations;
+}
+
+double SparsePCG::GetResidual() const {
+	return residual;
+}
\ No newline at end of file
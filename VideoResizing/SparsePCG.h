@@ -0,0 +1,69 @@
+#ifndef SPARSEPCG_H
+#define SPARSEPCG_H
+
+#include "common.h"
+#include "SparseMatrix.h"
+#include "SparseLDLT.h"
+
+/*
+Preconditioned conjugate gradient for a symmetric positive definite SparseMatrix.
+Solve starts from the x it is given, so a good guess such as the uniformly scaled
+control points cuts the iterations. The preconditioner is the diagonal (Jacobi) or
+a zero fill incomplete Cholesky factor, which falls back to Jacobi if it breaks down,
+or block Jacobi with every block, e.g. one keyframe, factored exactly by SparseLDLT.
+*/
+class SparsePCG {
+
+public:
+	enum {
+		PRECOND_JACOBI = 0,
+		PRECOND_IC0 = 1,
+		PRECOND_BLOCK_JACOBI = 2
+	} PRECOND_TYPE;
+
+private:
+	int preconditioner;
+	double tolerance;
+	int maxIterations;
+
+	int iterations;
+	double residual;
+	// Matrix the preconditioner was built for, Solve only accepts that one.
+	const SparseMatrix *preparedMat;
+	int preparedNonZeros;
+
+	// Preconditioner data, lower triangle of IC0 in compressed rows.
+	bool useIC0;
+	vector<double> invDiag;
+	vector<int> Lp, Lj;
+	vector<double> Lx;
+	bool useBlocks;
+	vector<int> blockOfRow;
+	vector< vector<int> > blockRows;
+	vector<SparseLDLT> blockFactors;
+
+	bool BuildIC0( const SparseMatrix &A );
+	bool BuildBlocks( const SparseMatrix &A );
+	void ApplyPreconditioner( const vector<double> &r, vector<double> &z ) const;
+
+public:
+	SparsePCG();
+
+	void SetPreconditioner( int _preconditioner );
+	// Stop once ||b - Ax|| <= tolerance * ||b||.
+	void SetTolerance( double _tolerance );
+	void SetMaxIterations( int _maxIterations );
+	// Block of every row, non-negative, for PRECOND_BLOCK_JACOBI.
+	void SetBlocks( const vector<int> &_blockOfRow );
+
+	// Builds the preconditioner for A, required before Solve. Solve asserts it is
+	// given the prepared matrix, call Prepare again after changing its values.
+	void Prepare( const SparseMatrix &A );
+	bool Solve( const SparseMatrix &A, const vector<double> &b, vector<double> &x );
+
+	int GetIterations() const;
+	double GetResidual() const;
+
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,373 @@
+#include "benchmark.h"
+
+double ElapsedMs( int64 startTick ) {
+	return (getTickCount() - startTick) * 1000.0 / getTickFrequency();
+}
+
+// The original serial per pixel smoothing, kept as the reference the parallel body must match bit for bit.
+static void SmoothSaliencyMapByPixelSerial( vector<KeyFrame> &frames, vector<Mat> &smoothedSaliencyMapVec ) {
+
+	int frameSpan = SALIENCY_SMOOTH_SPAN >> 1;
+	Size size = frames[0].size;
+	vector<double> smoothWeight;
+	vector<Mat> saliencyMapVec;
+
+	for ( int i = frameSpan; i < SALIENCY_SMOOTH_SPAN; i++ ) {
+		smoothWeight.push_back( exp( -(float)sqr( i - frameSpan ) / sqr( frameSpan ) ) );
+	}
+
+	for ( size_t i = 0; i < frames.size(); i++ ) {
+		saliencyMapVec.push_back( frames[i].GetSaliencyMap() );
+	}
+
+	smoothedSaliencyMapVec.clear();
+	for ( int i = 0; i < (int)frames.size(); i++ ) {
+
+		Mat smoothedSaliencyMap( size, CV_32FC1 );
+
+		for ( int y = 0; y < size.height; y++ ) {
+			for ( int x = 0; x < size.width; x++ ) {
+
+				Point2f p( x, y );
+				double sumSaliency = smoothWeight[0] * saliencyMapVec[i].at<float>( y, x );
+				int frameCount = 1;
+
+				for ( int j = 1; j <= frameSpan; j++ ) {
+					if ( i - j < 0 ) break;
+					Point2f flow = frames[i - j + 1].backwardFlowMap.at<Point2f>( FloorToInt( p.y ), FloorToInt( p.x ) );
+					p.x += flow.x;
+					p.y += flow.y;
+					if ( CheckOutside( p, size ) ) break;
+					sumSaliency += smoothWeight[j] * saliencyMapVec[i - j].at<float>( FloorToInt( p.y ), FloorToInt( p.x ) );
+					frameCount++;
+				}
+
+				p = Point2f( x, y );
+
+				for ( int j = 1; j <= frameSpan; j++ ) {
+					if ( i + j >= (int)frames.size() ) break;
+					Point2f flow = frames[i + j - 1].forwardFlowMap.at<Point2f>( FloorToInt( p.y ), FloorToInt( p.x ) );
+					p.x += flow.x;
+					p.y += flow.y;
+					if ( CheckOutside( p, size ) ) break;
+					sumSaliency += smoothWeight[j] * saliencyMapVec[i + j].at<float>( FloorToInt( p.y ), FloorToInt( p.x ) );
+					frameCount++;
+				}
+
+				sumSaliency /= frameCount;
+				smoothedSaliencyMap.at<float>( y, x ) = (float)sumSaliency;
+
+			}
+		}
+
+		normalize( smoothedSaliencyMap, smoothedSaliencyMap, 0, 1, NORM_MINMAX );
+		smoothedSaliencyMapVec.push_back( smoothedSaliencyMap );
+
+	}
+
+}
+
+void BenchmarkSmoothSaliency( const vector<KeyFrame> &frames ) {
+
+	printf( "Benchmark per-pixel saliency smoothing.\n" );
+
+	const int threadNumArray[4] = { 1, 8, 16, 32 };
+	int defaultThreadNum = getNumThreads();
+	vector<Mat> referenceMaps;
+	double referenceTime = 0;
+
+	{
+		vector<KeyFrame> tmpFrames( frames );
+		int64 startTick = getTickCount();
+		SmoothSaliencyMapByPixelSerial( tmpFrames, referenceMaps );
+		referenceTime = ElapsedMs( startTick );
+		printf( "\tSerial reference: %.2lf ms.\n", referenceTime );
+	}
+
+	for ( int k = 0; k < 4; k++ ) {
+
+		vector<KeyFrame> tmpFrames( frames );
+		vector<Mat> smoothedMaps;
+		setNumThreads( threadNumArray[k] );
+
+		int64 startTick = getTickCount();
+		SmoothSaliencyMapByPixel( tmpFrames, smoothedMaps );
+		double elapsed = ElapsedMs( startTick );
+
+		bool identical = true;
+		for ( size_t i = 0; i < smoothedMaps.size(); i++ ) {
+			if ( countNonZero( smoothedMaps[i] != referenceMaps[i] ) > 0 ) identical = false;
+		}
+
+		printf( "\tThreads %d: %.2lf ms, speedup %.2lf, %s.\n", threadNumArray[k], elapsed, referenceTime / elapsed, identical ? "identical" : "MISMATCH" );
+
+	}
+
+	setNumThreads( defaultThreadNum );
+
+	// Superpixel graph smoothing against the per pixel chains it approximates.
+	vector<KeyFrame> pixelFrames( frames ), graphFrames( frames );
+	SmoothSaliencyMapByPixel( pixelFrames );
+	int64 startTick = getTickCount();
+	SmoothSaliencyMap( graphFrames );
+	double graphTime = ElapsedMs( startTick );
+
+	double maxDiff = 0, sumDiff = 0;
+	int superpixelCount = 0;
+	for ( size_t i = 0; i < frames.size(); i++ ) {
+		for ( size_t k = 0; k < graphFrames[i].superpixelSaliency.size(); k++ ) {
+			double diff = abs( graphFrames[i].superpixelSaliency[k] - pixelFrames[i].superpixelSaliency[k] );
+			maxDiff = max( maxDiff, diff );
+			sumDiff += diff;
+			superpixelCount++;
+		}
+	}
+	printf( "\tSuperpixel graph: %.2lf ms, superpixel saliency vs per pixel max diff %.4lf, mean diff %.4lf.\n",
+		graphTime, maxDiff, sumDiff / max( superpixelCount, 1 ) );
+
+}
+
+void BenchmarkSlicAssign( const vector<KeyFrame> &frames ) {
+
+	printf( "Benchmark SLIC assignment kernel.\n" );
+
+	const int repeatNum = 5;
+	double referenceTime = 0, simdTime = 0;
+	int64 agreeCount = 0, pixelCount = 0;
+	int fullIterNum = 0, earlyIterNum = 0;
+	double earlyTime = 0, earlyResidual = 0;
+
+	for ( const auto &frame : frames ) {
+
+		int sz = frame.rows * frame.cols;
+		vector<int> referenceLabel;
+
+		for ( int k = 0; k < 2; k++ ) {
+			for ( int r = 0; r < repeatNum; r++ ) {
+
+				SLIC slic;
+				slic.SetSimdAssign( k == 1 );
+
+				int64 startTick = getTickCount();
+				slic.GenerateSuperpixelsFromLab( frame.CIELabImg, MAX_SUPERPIXEL_NUM );
+				double elapsed = ElapsedMs( startTick );
+
+				if ( k == 0 ) referenceTime += elapsed;
+				else simdTime += elapsed;
+
+				if ( r > 0 ) continue;
+				int *label = slic.GetLabel();
+				if ( k == 0 ) {
+					referenceLabel.assign( label, label + sz );
+				} else {
+					for ( int i = 0; i < sz; i++ ) {
+						if ( label[i] == referenceLabel[i] ) agreeCount++;
+					}
+					pixelCount += sz;
+				}
+
+			}
+		}
+
+		// Same SIMD run with the keyframe convergence thresholds.
+		SLIC slic;
+		slic.GenerateSuperpixelsFromLab( frame.CIELabImg, MAX_SUPERPIXEL_NUM );
+		fullIterNum += slic.GetStats().iterations;
+		slic.SetConvergence( SUPERPIXEL_CONVERGE_SHIFT, SUPERPIXEL_CONVERGE_CHANGE );
+		slic.GenerateSuperpixelsFromLab( frame.CIELabImg, MAX_SUPERPIXEL_NUM );
+		earlyIterNum += slic.GetStats().iterations;
+		earlyTime += slic.GetStats().elapsedMs;
+		earlyResidual += slic.GetStats().residual;
+
+	}
+
+	int runNum = repeatNum * frames.size();
+	int frameNum = max( (int)frames.size(), 1 );
+	printf( "\tReference: %.2lf ms/frame, SIMD: %.2lf ms/frame, speedup %.2lf.\n", referenceTime / runNum, simdTime / runNum, referenceTime / simdTime );
+	printf( "\tLabel agreement: %.4lf%%.\n", 100.0 * agreeCount / max( pixelCount, (int64)1 ) );
+	printf( "\tEarly exit: %.2lf of %.2lf iterations, %.2lf ms/frame clustering, residual %.3lf px.\n",
+		(double)earlyIterNum / frameNum, (double)fullIterNum / frameNum, earlyTime / frameNum, earlyResidual / frameNum );
+
+}
+
+void BenchmarkSupervoxel( const vector<KeyFrame> &frames ) {
+
+	printf( "Benchmark supervoxels.\n" );
+
+	const int repeatNum = 3;
+	int frameNum = max( (int)frames.size(), 1 );
+	vector<Mat> labImgs;
+	for ( const auto &frame : frames ) {
+		labImgs.push_back( frame.CIELabImg );
+	}
+
+	// One SLIC run per keyframe, as without SUPERVOXEL_SEGMENTATION.
+	SlicWorkspace frameWorkspace;
+	int64 startTick = getTickCount();
+	for ( int r = 0; r < repeatNum; r++ ) {
+		for ( const auto &labImg : labImgs ) {
+			SLIC slic( frameWorkspace );
+			slic.GenerateSuperpixelsFromLab( labImg, MAX_SUPERPIXEL_NUM );
+		}
+	}
+	double frameTime = ElapsedMs( startTick ) / (repeatNum * frameNum);
+
+	// The whole stack at once, the first run allocates the workspace and the later ones reuse it.
+	SlicWorkspace stackWorkspace;
+	double firstTime = 0, reuseTime = 0;
+	int supervoxelNum = 0;
+	for ( int r = 0; r <= repeatNum; r++ ) {
+		SLIC slic( stackWorkspace );
+		startTick = getTickCount();
+		slic.GenerateSupervoxelsFromLab( labImgs, MAX_SUPERPIXEL_NUM, SUPERVOXEL_FRAME_SPAN );
+		double elapsed = ElapsedMs( startTick ) / frameNum;
+		if ( r == 0 ) firstTime = elapsed;
+		else reuseTime += elapsed / repeatNum;
+		supervoxelNum = slic.GetSupervoxelNum();
+	}
+
+	printf( "\t%d frames: supervoxels %.2lf ms/frame (first run %.2lf), independent SLIC %.2lf ms/frame, ratio %.2lf, %d supervoxels.\n",
+		frameNum, reuseTime, firstTime, frameTime, reuseTime / max( frameTime, VERY_SMALL ), supervoxelNum );
+
+}
+
+// The string keyed deduplication MarkFirstEdges replaced, kept as its reference.
+static void MarkFirstEdgesByString( const vector<Vec4f> &edgeList, const Mat &pointsMap, vector<bool> &edgeFirst ) {
+
+	Size size = pointsMap.size();
+	map<string, int> edgeExist;
+	edgeFirst.assign( edgeList.size(), false );
+
+	for ( size_t k = 0; k < edgeList.size(); k++ ) {
+
+		const Vec4f &e = edgeList[k];
+		Point2f p0( e.val[0], e.val[1] );
+		Point2f p1( e.val[2], e.val[3] );
+
+		if ( CheckOutside( p0, size ) || CheckOutside( p1, size ) ) {
+			continue;
+		}
+
+		int index0 = pointsMap.at<int>( p0 );
+		int index1 = pointsMap.at<int>( p1 );
+
+		string edgeHash0 = to_string( index0 ) + " " + to_string( index1 );
+		string edgeHash1 = to_string( index1 ) + " " + to_string( index0 );
+		if ( edgeExist.count( edgeHash0 ) > 0 ) continue;
+		if ( edgeExist.count( edgeHash1 ) > 0 ) continue;
+		edgeExist[edgeHash0] = 1;
+		edgeExist[edgeHash1] = 1;
+		edgeFirst[k] = true;
+
+	}
+
+}
+
+// Times the edge deduplication alone on the Delaunay edge lists of the frames.
+static void BenchmarkEdgeDedup( const vector<KeyFrame> &frames ) {
+
+	const int repeatNum = 20;
+	vector< vector<Vec4f> > edgeLists( frames.size() );
+	vector<Mat> pointsMaps( frames.size() );
+	int edgeSum = 0;
+
+	for ( size_t i = 0; i < frames.size(); i++ ) {
+		Subdiv2D subdiv( Rect( 0, 0, frames[i].size.width, frames[i].size.height ) );
+		pointsMaps[i] = Mat( frames[i].size, CV_32SC1, Scalar( -1 ) );
+		for ( int j = 0; j < frames[i].superpixelNum; j++ ) {
+			subdiv.insert( frames[i].superpixelCenter[j] );
+			pointsMaps[i].at<int>( frames[i].superpixelCenter[j] ) = j;
+		}
+		subdiv.getEdgeList( edgeLists[i] );
+		edgeSum += edgeLists[i].size();
+	}
+
+	vector<bool> stringFirst, keyFirst;
+	bool identical = true;
+	double stringTime = 0, keyTime = 0;
+
+	for ( size_t i = 0; i < frames.size(); i++ ) {
+
+		int64 startTick = getTickCount();
+		for ( int r = 0; r < repeatNum; r++ ) MarkFirstEdgesByString( edgeLists[i], pointsMaps[i], stringFirst );
+		stringTime += ElapsedMs( startTick ) / repeatNum;
+
+		startTick = getTickCount();
+		for ( int r = 0; r < repeatNum; r++ ) MarkFirstEdges( edgeLists[i], pointsMaps[i], keyFirst );
+		keyTime += ElapsedMs( startTick ) / repeatNum;
+
+		if ( stringFirst != keyFirst ) identical = false;
+
+	}
+
+	printf( "\t\tEdge dedup of %d edges: map<string,int> %.3lf ms, packed keys %.3lf ms, speedup %.2lf, %s.\n",
+		edgeSum, stringTime, keyTime, stringTime / max( keyTime, VERY_SMALL ), identical ? "identical" : "MISMATCH" );
+
+}
+
+void BenchmarkControlGraph( const vector<KeyFrame> &frames, const string &videoName ) {
+
+	printf( "Benchmark control graph build.\n" );
+
+	const int superpixelNumArray[4] = { 250, 500, 1000, 2000 };
+	SlicWorkspace workspace;
+
+	for ( int k = 0; k < 4; k++ ) {
+
+		// Resegment copies densely, with their own label maps.
+		vector<KeyFrame> tmpFrames( frames );
+		int superpixelSum = 0;
+		for ( auto &frame : tmpFrames ) {
+			frame.labelMap = LabelMap();
+			frame.superpixelNum = superpixelNumArray[k];
+			frame.SegSuperpixel( workspace );
+			frame.ReduceSuperpixelStats();
+			frame.superpixelSaliency.assign( frame.superpixelNum, 1.0 );
+			superpixelSum += frame.superpixelNum;
+		}
+
+		// The adjacency graph first, then the Delaunay edges with bound points from it.
+		for ( int path = 0; path < 2; path++ ) {
+
+			Deformation deformation( tmpFrames, videoName );
+			deformation.SetAdjacencyGraph( path == 0 );
+			int64 startTick = getTickCount();
+			deformation.InitDeformation( 1.0, 1.0 );
+			double elapsed = ElapsedMs( startTick );
+
+			printf( "\t%d superpixels/frame, %s: %.2lf ms, %d control points.\n", superpixelSum / max( (int)tmpFrames.size(), 1 ),
+				path == 0 ? "adjacency" : "Delaunay", elapsed, deformation.controlGraph.pointNum );
+
+		}
+
+		BenchmarkEdgeDedup( tmpFrames );
+
+	}
+
+}
+
+void RunBenchmarks( const string &videoName ) {
+
+	vector<int> shotArr, keyArr;
+	ReadShotCut( shotArr, videoName );
+	ReadKeyArr( keyArr, videoName );
+
+	if ( shotArr.size() < 2 ) {
+		cerr << "No shotcut to benchmark." << endl;
+		return;
+	}
+
+	vector<KeyFrame> keyFrames;
+	ReadKeyFrames( shotArr[0], shotArr[1], keyArr, keyFrames, videoName );
+
+	QuantizeFrames( keyFrames );
+	CalcMotionMap( keyFrames );
+	CalcSuperpixel( keyFrames );
+	CalcSaliencyMap( keyFrames );
+
+	BenchmarkSmoothSaliency( keyFrames );
+	BenchmarkSlicAssign( keyFrames );
+	BenchmarkSupervoxel( keyFrames );
+	BenchmarkControlGraph( keyFrames, videoName );
+
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "common.h"
+#include "io.h"
+#include "pretreat.h"
+#include "saliency.h"
+#include "KeyFrame.h"
+#include "slic.h"
+#include "Deformation.h"
+
+double ElapsedMs( int64 startTick );
+
+void BenchmarkSmoothSaliency( const vector<KeyFrame> & );
+
+void BenchmarkSlicAssign( const vector<KeyFrame> & );
+
+void BenchmarkSupervoxel( const vector<KeyFrame> & );
+
+void BenchmarkControlGraph( const vector<KeyFrame> &, const string &videoName );
+
+void RunBenchmarks( const string &videoName );
+
+#endif
\ No newline at end of file
@@ -16,7 +16,6 @@ const double INF = 1e10;
 const double eps = 1e-8;
 const double VERY_SMALL = 1e-5;
 const double SMALL_LEN = 5.0f;
-const double ITER_TERMINATE = 0.1;
 const int MIN_ENERGY_ITERS = 300;
 const int NEIGHBORS_NUM = 8;
 const Point neighbors[NEIGHBORS_NUM] = {
@@ -40,9 +39,32 @@ const int THRES_SHOTCUT = 10;
 const int THRES_KEYFRAME = 2;
 const int QUANTIZE_LEVEL = 5;
 const int MAX_SUPERPIXEL_NUM = 30;
+const double SUPERPIXEL_CONVERGE_SHIFT = 0.5;
+const double SUPERPIXEL_CONVERGE_CHANGE = 0.001;
+const int SUPERPIXEL_PROXY_STEP = 24;
+const bool SUPERPIXEL_WARM_START = true;
+const int SUPERPIXEL_WARM_ITERS = 4;
+const double SUPERPIXEL_WARM_CONVERGE = 0.25;
+const bool SUPERVOXEL_SEGMENTATION = false;
+const int SUPERVOXEL_FRAME_SPAN = 4;
 const double SIGMA_COLOR = 40;
 const double SIGMA_DIST = 200;
 const int SALIENCY_SMOOTH_SPAN = 11;
+const int SALIENCY_SMOOTH_TILE_ROWS = 16;
+const int SPECTRAL_RESIDUAL_WIDTH = 64;
+const double SALIENCY_FLOW_SCALE = 0.25;
+const int LABEL_REDUCE_STRIPE_ROWS = 32;
+const bool CONTROL_GRAPH_FROM_ADJACENCY = true;
+const int ENERGY_SOLVER_DENSE = 0;
+const int ENERGY_SOLVER_LDLT = 1;
+const int ENERGY_SOLVER_PCG = 2;
+const int ENERGY_SOLVER = ENERGY_SOLVER_LDLT;
+const double PCG_TOLERANCE = 1e-6;
+const int PCG_MAX_ITERS = 500;
+const bool PCG_INCOMPLETE_CHOLESKY = true;
+const bool ENERGY_BLOCK_PARALLEL = true;
+const double ENERGY_PROXIMAL_WEIGHT = 0.5;
+const double ENERGY_REL_TERMINATE = 1e-4;
 
 const double ALPHA_SALIENCY = 10;
 const double ALPHA_OBJECT = 1;
@@ -15,10 +15,19 @@ string GetFramesFolderPath( const string &videoName ) {
 
 }
 
-string GetResultsFolderPath( const string &videoName ) {
+string GetTargetName( double deformedScaleX, double deformedScaleY ) {
+
+	char name[64];
+	sprintf( name, "%gx%g", deformedScaleX, deformedScaleY );
+	return name;
+
+}
+
+string GetResultsFolderPath( const string &videoName, const string &targetName ) {
 
 	string rootPath = GetRootFolderPath( videoName );
-	return rootPath + "results/";
+	if ( targetName.empty() ) return rootPath + "results/";
+	return rootPath + "results_" + targetName + "/";
 
 }
 
@@ -29,16 +38,17 @@ string GetKeyFramesFolderPath( const string &videoName ) {
 
 }
 
-string GetOutputVideoPath( const string &videoName, int type ) {
+string GetOutputVideoPath( const string &videoName, int type, const string &targetName ) {
 
 	int splitPos = videoName.find( '.' );
 	string name = videoName.substr( 0, splitPos );
+	string suffix = targetName.empty() ? "" : "_" + targetName;
 	
 	string path;
 	if ( type == RESIZED_VIDEO ) {
-		path = TEST_PATH + name + "/" + name + "_resize.avi";
+		path = TEST_PATH + name + "/" + name + "_resize" + suffix + ".avi";
 	} else if ( type == MIXED_VIDEO ) {
-		path = TEST_PATH + name + "/" + name + "_mixed.avi";
+		path = TEST_PATH + name + "/" + name + "_mixed" + suffix + ".avi";
 	}
 	return path;
 
@@ -175,20 +185,22 @@ void WriteKeyFrameEdgeImg( int frameId, const Mat &edgeImg, const string &videoN
 
 }
 
-void WriteDeformedImg( int frameId, const Mat &img, const string &videoName ) {
+void WriteDeformedImg( int frameId, const Mat &img, const string &videoName, const string &targetName ) {
 
-	string resultsFolderPath = GetResultsFolderPath( videoName );
+	string resultsFolderPath = GetResultsFolderPath( videoName, targetName );
 	string frameName( resultsFolderPath + to_string( frameId ) + ".png" );
 	imwrite( frameName, img );
 
 }
 
-void WriteResizedVideo( const string &videoName ) {
+void WriteResizedVideo( const string &videoName, const string &targetName ) {
 	
 	printf( "Write output video.\n" );
 
-	string videoPath = GetOutputVideoPath( videoName, RESIZED_VIDEO );
-	string resultsFolderPath = GetResultsFolderPath( videoName );
+	string videoPath = GetOutputVideoPath( videoName, RESIZED_VIDEO, targetName );
+	string resultsFolderPath = GetResultsFolderPath( videoName, targetName );
+	
+	string framesFolderPath = GetFramesFolderPath( videoName );
 	
 	string frameName( resultsFolderPath + to_string( 0 ) + ".png" );
 	Mat img = imread( frameName );
@@ -197,25 +209,31 @@ void WriteResizedVideo( const string &videoName ) {
 	video.open( videoPath, CV_FOURCC( 'M', 'J', 'P', 'G' ), 15, img.size() );
 	video << img;
 
+	// Every input frame has a resized one, a gap means the resize step did not finish.
 	int frameIndex = 1;
 	while ( true ) {
 		frameName = resultsFolderPath + to_string( frameIndex ) + ".png" ;
 		img = imread( frameName );
-		if ( img.empty() ) break;
+		if ( img.empty() ) {
+			if ( !imread( framesFolderPath + to_string( frameIndex ) + ".png" ).empty() ) {
+				cerr << "Missing resized frame " << frameIndex << ", the output video stops there.\n";
+			}
+			break;
+		}
 		video << img;
 		frameIndex++;
 	}
 
 }
 
-void WriteMixedVideo( const string &videoName, double deformedScaleX, double deformedScaleY ) {
+void WriteMixedVideo( const string &videoName, double deformedScaleX, double deformedScaleY, const string &targetName ) {
 
 	printf( "Write mixed input & output video.\n" );
 
 	const int gap = 10;
 
-	string videoPath = GetOutputVideoPath( videoName, MIXED_VIDEO );
-	string resultsFolderPath = GetResultsFolderPath( videoName );
+	string videoPath = GetOutputVideoPath( videoName, MIXED_VIDEO, targetName );
+	string resultsFolderPath = GetResultsFolderPath( videoName, targetName );
 	string framesFolderPath = GetFramesFolderPath( videoName );
 
 	string frameName = framesFolderPath + to_string( 0 ) + ".png";
@@ -9,11 +9,14 @@ string GetRootFolderPath( const string &videoName );
 
 string GetFramesFolderPath( const string &videoName );
 
-string GetResultsFolderPath( const string &videoName );
+// Target names tell the outputs of several deformed scales apart, empty for a single one.
+string GetTargetName( double deformedScaleX, double deformedScaleY );
+
+string GetResultsFolderPath( const string &videoName, const string &targetName = "" );
 
 string GetKeyFramesFolderPath( const string &videoName );
 
-string GetOutputVideoPath( const string &videoName, int type );
+string GetOutputVideoPath( const string &videoName, int type, const string &targetName = "" );
 
 void ConvertVideoToFrames( const string &videoName );
 
@@ -27,13 +30,13 @@ void ReadFrames( int, int, vector<Mat> &, const string &videoName  );
 
 void WriteKeyFrameEdgeImg( int frameId, const Mat &edgeImg, const string &videoName );
 
-void WriteDeformedImg( int frameId, const Mat &img, const string &videoName );
+void WriteDeformedImg( int frameId, const Mat &img, const string &videoName, const string &targetName = "" );
 
 #define RESIZED_VIDEO 0
 #define MIXED_VIDEO 1
 
-void WriteResizedVideo( const string &videoName );
+void WriteResizedVideo( const string &videoName, const string &targetName = "" );
 
-void WriteMixedVideo( const string &videoName, double deformedScaleX, double deformedScaleY );
+void WriteMixedVideo( const string &videoName, double deformedScaleX, double deformedScaleY, const string &targetName = "" );
 
 #endif
\ No newline at end of file
@@ -11,9 +11,29 @@
 #include "io.h"
 #include "pretreat.h"
 #include "saliency.h"
+#include "SaliencyProvider.h"
 #include "KeyFrame.h"
 #include "Deformation.h"
 #include "Render.h"
+#include "benchmark.h"
+
+bool ParseScaleList( const string &arg, vector<double> &scales ) {
+
+	size_t st = 0;
+	while ( st <= arg.size() ) {
+		size_t ed = arg.find( ',', st );
+		if ( ed == string::npos ) ed = arg.size();
+		// Empty, malformed and non-positive scales are all rejected.
+		string token = arg.substr( st, ed - st );
+		char *tokenEnd;
+		double scale = strtod( token.c_str(), &tokenEnd );
+		if ( token.empty() || *tokenEnd != '\0' || !(scale > 0) ) return false;
+		scales.push_back( scale );
+		st = ed + 1;
+	}
+	return true;
+
+}
 
 int main( int argc, char *argv[] ) {
 
@@ -26,7 +46,7 @@ int main( int argc, char *argv[] ) {
 	string videoName = argv[1];
 	
 	// Get run_type
-	const string runTypeArray[4] = { "all", "import", "resize", "export" };
+	const string runTypeArray[5] = { "all", "import", "resize", "export", "benchmark" };
 	string runType;
 	
 	if (!CheckEleExist(runTypeArray, argv[2])) {
@@ -34,10 +54,38 @@ int main( int argc, char *argv[] ) {
 	}
 	runType = argv[2];
 
-	// Get deformed scale.
-	double deformedScaleX, deformedScaleY;
-	deformedScaleX = atof( argv[3] );
-	deformedScaleY = atof( argv[4] );
+	// Get deformed scales, comma separated lists give several targets sharing one control graph.
+	vector<double> deformedScaleX, deformedScaleY;
+	if ( !ParseScaleList( argv[3], deformedScaleX ) || !ParseScaleList( argv[4], deformedScaleY ) ) {
+		cerr << "Wrong deformed scale argument, expected positive comma separated scales.";
+		return -2;
+	}
+
+	if ( deformedScaleX.size() != deformedScaleY.size() ) {
+		cerr << "Deformed scale lists differ in length.";
+		return -2;
+	}
+
+	int targetNum = deformedScaleX.size();
+	vector<string> targetNames( targetNum );
+	if ( targetNum > 1 ) {
+		for ( int t = 0; t < targetNum; t++ ) {
+			targetNames[t] = GetTargetName( deformedScaleX[t], deformedScaleY[t] );
+		}
+	}
+
+	// Get saliency backend.
+	const string saliencyTypeArray[2] = { "contrast", "spectral" };
+	string saliencyType = "contrast";
+
+	if ( argc > 5 ) {
+		if ( !CheckEleExist( saliencyTypeArray, argv[5] ) ) {
+			cerr << "Wrong saliencyType argument.";
+		}
+		saliencyType = argv[5];
+	}
+
+	Ptr<SaliencyProvider> saliencyProvider = CreateSaliencyProvider( saliencyType );
 
 	/*
 	1. Convert video to frames.
@@ -53,12 +101,13 @@ int main( int argc, char *argv[] ) {
 	2.     Read keyframes.
 	3.     For each keyframe:
 	4.         Segment keyframe to superpixels.
-	5.         Calculate keyframe salient map.
+	5.         Calculate keyframe salient map with the chosen saliency backend.
 	6.         Build deformation spatial constraints.
 	7.     Build deformation temporal constraints.
-	8.     Solve deformation energy functions.
-	9.     Calculate pixel-wise deformation map.
-	10.    Apply keyframe deformation map to other frames.
+	8.     For each target scale:
+	9.         Solve deformation energy functions.
+	10.        Calculate pixel-wise deformation map.
+	11.        Apply keyframe deformation map to every frame of the shot.
 	*/
 	if ( runType == "all" || runType == "resize" ) {
 		
@@ -66,31 +115,34 @@ int main( int argc, char *argv[] ) {
 		ReadShotCut( shotArr, videoName );
 		ReadKeyArr( keyArr, videoName );
 
+		for ( int t = 0; t < targetNum; t++ ) {
+			_mkdir( GetResultsFolderPath( videoName, targetNames[t] ).c_str() );
+		}
+
 		for ( size_t i = 1; i < shotArr.size(); i++ ) {
 
 			vector<KeyFrame> keyFrames;
 			ReadKeyFrames( shotArr[i - 1], shotArr[i], keyArr, keyFrames, videoName );
 
-			QuantizeFrames( keyFrames );
-			CalcSuperpixel( keyFrames );
-			// SegEdges( keyFrames );
+			saliencyProvider->CalcSaliency( keyFrames );
 
-			CalcSaliencyMap( keyFrames );
-			SmoothSaliencyMap( keyFrames );
+			vector<Mat> frames;
+			ReadFrames( shotArr[i - 1], shotArr[i], frames, videoName );
 
+			// The graph and the factorization of the first target are reused by the others.
 			Deformation deformation( keyFrames, videoName );
-			deformation.InitDeformation( deformedScaleX, deformedScaleY );
-			deformation.MinimizeEnergy();
+			for ( int t = 0; t < targetNum; t++ ) {
 
-			Render render( deformation, deformation.controlPoints, deformation.frames );
-			render.CalcDeformedMaps();
-			render.RenderKeyFrames();
-			// deformation.CalcDeformedMap();
-			// deformation.RenderKeyFrames();
+				deformation.InitDeformation( deformedScaleX[t], deformedScaleY[t] );
+				deformation.MinimizeEnergy();
 
-			vector<Mat> frames;
-			// ReadFrames( shotArr[i - 1], shotArr[i], frames, videoName );
-			// deformation.RenderFrames( frames, shotArr[i - 1], shotArr[i] );
+				Render render( deformation, deformation.controlGraph, deformation.frames );
+				render.CalcDeformedMaps();
+				render.RenderFrames( frames, shotArr[i - 1], videoName, targetNames[t] );
+				// deformation.CalcDeformedMap();
+				// deformation.RenderKeyFrames();
+
+			}
 
 			cout << endl;
 
@@ -100,8 +152,16 @@ int main( int argc, char *argv[] ) {
 
 	if ( runType == "all" || runType == "export" ) {
 
-		WriteResizedVideo( videoName );
-		WriteMixedVideo( videoName, deformedScaleX, deformedScaleY );
+		for ( int t = 0; t < targetNum; t++ ) {
+			WriteResizedVideo( videoName, targetNames[t] );
+			WriteMixedVideo( videoName, deformedScaleX[t], deformedScaleY[t], targetNames[t] );
+		}
+
+	}
+
+	if ( runType == "benchmark" ) {
+
+		RunBenchmarks( videoName );
 
 	}
 
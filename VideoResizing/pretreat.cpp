@@ -198,14 +198,43 @@ void QuantizeFrames( vector<KeyFrame> &frames ) {
 	}
 }
 
+void CalcSupervoxel( vector<KeyFrame> &frames ) {
+
+	vector<Mat> labImgs;
+	for ( const auto &frame : frames ) {
+		labImgs.push_back( frame.CIELabImg );
+	}
+
+	SLIC slic;
+	slic.GenerateSupervoxelsFromLab( labImgs, MAX_SUPERPIXEL_NUM, SUPERVOXEL_FRAME_SPAN );
+
+	int **label = slic.GetSupervoxelLabel();
+	for ( size_t i = 0; i < frames.size(); i++ ) {
+		frames[i].SetSupervoxelLabel( label[i], slic.GetSupervoxelNum() );
+	}
+
+}
+
 void CalcSuperpixel( vector<KeyFrame> &frames ) {
 
 	printf( "Calculate key frames superpixels.\n" );
 
+	if ( SUPERVOXEL_SEGMENTATION ) {
+		CalcSupervoxel( frames );
+	} else {
+		// One workspace for the shot, so the keyframes reuse SLIC's buffers.
+		SlicWorkspace workspace;
+		for ( size_t i = 0; i < frames.size(); i++ ) {
+			if ( SUPERPIXEL_WARM_START && i > 0 && !frames[i - 1].forwardFlowMap.empty() ) {
+				frames[i].SegSuperpixel( frames[i - 1], workspace );
+			} else {
+				frames[i].SegSuperpixel( workspace );
+			}
+		}
+	}
+
 	for ( auto &frame : frames ) {
-		frame.SegSuperpixel();
-		frame.MarkBoundLabel();
-		frame.CalcSuperpixelColorHist();
+		frame.ReduceSuperpixelStats();
 	}
 }
 
@@ -7,6 +7,8 @@
 
 void SegFramesToShotCutKeyFrames( const string &videoName );
 
+void CalcSupervoxel( vector<KeyFrame> & );
+
 void CalcSuperpixel( vector<KeyFrame> & );
 
 bool CmpVec3f0( const Vec3f &, const Vec3f & );
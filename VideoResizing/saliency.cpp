@@ -42,24 +42,50 @@ void CalcMotion( const Mat &flowMap, Mat &localMotionMap, Point2f &globalMotion
 	}
 }
 
-void CalcSaliencyMap( vector<KeyFrame> &frames ) {
+void CalcFlowMap( const Mat &prevGrayImg, const Mat &nextGrayImg, Mat &flowMap, double scale ) {
 
-	printf( "Calculate key frames saliency map.\n" );
+	if ( scale >= 1 ) {
+		calcOpticalFlowFarneback( prevGrayImg, nextGrayImg, flowMap, 0.5, 3, 15, 3, 5, 1.2, 0 );
+		return;
+	}
+
+	// Estimate the flow on a downscaled proxy, then bring it back to full resolution.
+	Mat prevProxy, nextProxy, proxyFlowMap;
+	resize( prevGrayImg, prevProxy, Size(), scale, scale, INTER_AREA );
+	resize( nextGrayImg, nextProxy, Size(), scale, scale, INTER_AREA );
+	calcOpticalFlowFarneback( prevProxy, nextProxy, proxyFlowMap, 0.5, 3, 15, 3, 5, 1.2, 0 );
+	resize( proxyFlowMap, flowMap, prevGrayImg.size(), 0, 0, INTER_LINEAR );
+	flowMap *= 1.0 / scale;
+
+}
+
+void CalcOpticalFlow( vector<KeyFrame> &frames, double scale ) {
 
 	printf( "\tCalculate optical flow.\n" );
 
+	for ( size_t i = 1; i < frames.size(); i++ ) {
+		CalcFlowMap( frames[i - 1].grayImg, frames[i].grayImg, frames[i - 1].forwardFlowMap, scale );
+		CalcFlowMap( frames[i].grayImg, frames[i - 1].grayImg, frames[i].backwardFlowMap, scale );
+	}
+
+}
+
+void CalcMotionMap( vector<KeyFrame> &frames ) {
+
+	printf( "Calculate key frames motion map.\n" );
+
+	CalcOpticalFlow( frames, 1.0 );
+
 	for ( size_t i = 1; i < frames.size(); i++ ) {
 
 		Mat localMotionMap;
 		Point2f globalMotion;
 
-		calcOpticalFlowFarneback( frames[i - 1].grayImg, frames[i].grayImg, frames[i - 1].forwardFlowMap, 0.5, 3, 15, 3, 5, 1.2, 0 );
 		CalcMotion( frames[i - 1].forwardFlowMap, localMotionMap, globalMotion );
 
 		frames[i - 1].forwardLocalMotionMap = localMotionMap.clone();
 		frames[i - 1].forwardGlobalMotion = globalMotion;
 
-		calcOpticalFlowFarneback( frames[i].grayImg, frames[i - 1].grayImg, frames[i].backwardFlowMap, 0.5, 3, 15, 3, 5, 1.2, 0 );
 		CalcMotion( frames[i].backwardFlowMap, localMotionMap, globalMotion );
 
 		frames[i].backwardLocalMotionMap = localMotionMap;
@@ -70,6 +96,12 @@ void CalcSaliencyMap( vector<KeyFrame> &frames ) {
 
 	}
 
+}
+
+void CalcSaliencyMap( vector<KeyFrame> &frames ) {
+
+	printf( "Calculate key frames saliency map.\n" );
+
 	printf( "\tCalculate temporal contrast.\n" );
 
 	for ( auto &frame : frames ) {
@@ -88,78 +120,327 @@ void CalcSaliencyMap( vector<KeyFrame> &frames ) {
 
 }
 
+Mat CalcSpectralResidualMap( const Mat &grayImg ) {
+
+	// Spectral residual saliency (Hou and Zhang, CVPR 2007) on a small proxy image.
+	int proxyWidth = min( SPECTRAL_RESIDUAL_WIDTH, grayImg.cols );
+	int proxyHeight = max( 1, RoundToInt( (double)grayImg.rows * proxyWidth / grayImg.cols ) );
+
+	Mat proxyImg;
+	resize( grayImg, proxyImg, Size( proxyWidth, proxyHeight ), 0, 0, INTER_AREA );
+	proxyImg.convertTo( proxyImg, CV_32FC1, 1.0 / 255 );
+
+	Mat planes[2] = { proxyImg, Mat::zeros( proxyImg.size(), CV_32FC1 ) };
+	Mat complexImg;
+	merge( planes, 2, complexImg );
+	dft( complexImg, complexImg );
+	split( complexImg, planes );
+
+	Mat amplitude, angle, logAmplitude, smoothedLogAmplitude;
+	cartToPolar( planes[0], planes[1], amplitude, angle );
+	log( amplitude + VERY_SMALL, logAmplitude );
+	blur( logAmplitude, smoothedLogAmplitude, Size( 3, 3 ) );
+	exp( logAmplitude - smoothedLogAmplitude, amplitude );
+
+	polarToCart( amplitude, angle, planes[0], planes[1] );
+	merge( planes, 2, complexImg );
+	dft( complexImg, complexImg, DFT_INVERSE | DFT_SCALE );
+	split( complexImg, planes );
+
+	Mat residualMap;
+	magnitude( planes[0], planes[1], residualMap );
+	residualMap = residualMap.mul( residualMap );
+	GaussianBlur( residualMap, residualMap, Size( 0, 0 ), 2.5 );
+	normalize( residualMap, residualMap, 0, 1, NORM_MINMAX );
+
+	return residualMap;
+
+}
+
+void CalcSpectralResidualSaliency( vector<KeyFrame> &frames ) {
+
+	printf( "Calculate key frames spectral residual saliency.\n" );
+
+	CalcOpticalFlow( frames, SALIENCY_FLOW_SCALE );
+
+	for ( auto &frame : frames ) {
+		resize( CalcSpectralResidualMap( frame.grayImg ), frame.pixelSaliencyMap, frame.size, 0, 0, INTER_LINEAR );
+	}
+
+}
+
+void CalcSuperpixelGraph( const KeyFrame &srcFrame, const Mat &flowMap, const KeyFrame &dstFrame, SuperpixelGraph &graph ) {
+
+	// Count how many pixels of each source superpixel land in each destination superpixel.
+	// Only the pairs that occur are kept, as packed (src, dst) keys; neighbouring pixels mostly
+	// hit the same pair, so a repeat of the last key only bumps its count.
+	vector< pair<uint64, int> > linkCount;
+	vector<int> srcCard( srcFrame.superpixelNum, 0 );
+
+	for ( int y = 0; y < srcFrame.rows; y++ ) {
+		for ( int x = 0; x < srcFrame.cols; x++ ) {
+
+			int srcLabel = srcFrame.labelMap.At( y, x );
+			srcCard[srcLabel]++;
+
+			Point2f flow = flowMap.at<Point2f>( y, x );
+			Point2f p( x + flow.x, y + flow.y );
+			if ( CheckOutside( p, dstFrame.size ) ) continue;
+
+			int dstLabel = dstFrame.labelMap.At( FloorToInt( p.y ), FloorToInt( p.x ) );
+			uint64 key = ((uint64)srcLabel << 32) | (unsigned)dstLabel;
+			if ( !linkCount.empty() && linkCount.back().first == key ) {
+				linkCount.back().second++;
+			} else {
+				linkCount.push_back( make_pair( key, 1 ) );
+			}
+
+		}
+	}
+
+	sort( linkCount.begin(), linkCount.end() );
+
+	// Links keep the fraction of source pixels, so the mass flowing out of the frame is lost as in the pixel chain.
+	graph = SuperpixelGraph( srcFrame.superpixelNum );
+	for ( size_t k = 0; k < linkCount.size(); ) {
+		uint64 key = linkCount[k].first;
+		int count = 0;
+		for ( ; k < linkCount.size() && linkCount[k].first == key; k++ ) count += linkCount[k].second;
+		int i = (int)(key >> 32), j = (int)(key & 0xffffffff);
+		graph[i].push_back( make_pair( j, (double)count / srcCard[i] ) );
+	}
+
+}
+
 void SmoothSaliencyMap( vector<KeyFrame> &frames ) {
 
 // #define SMOOTH_SALIENCY_MAP
 	printf( "Smooth key frames saliency map.\n" );
 
 	int frameSpan = SALIENCY_SMOOTH_SPAN >> 1;
-	Size size = frames[0].saliencyMap.size();
+	int frameNum = frames.size();
 	vector<double> smoothWeight;
-	vector<Mat> smoothedSaliencyMapVec;
 
 	for ( int i = frameSpan; i < SALIENCY_SMOOTH_SPAN; i++ ) {
 		smoothWeight.push_back( exp( -(float)sqr( i - frameSpan ) / sqr( frameSpan ) ) );
 	}
 
-#ifdef SMOOTH_SALIENCY_MAP
-	//cout << frameSpan << endl;
-	//for ( auto x : smoothWeight ) cout << x << endl;
-#endif
+	// Build the superpixel correspondence graph between adjacent keyframes once.
+	vector<SuperpixelGraph> forwardGraph( frameNum ), backwardGraph( frameNum );
+	for ( int i = 1; i < frameNum; i++ ) {
+		CalcSuperpixelGraph( frames[i - 1], frames[i - 1].forwardFlowMap, frames[i], forwardGraph[i - 1] );
+		CalcSuperpixelGraph( frames[i], frames[i].backwardFlowMap, frames[i - 1], backwardGraph[i] );
+	}
 
-	for ( int i = 0; i < (int)frames.size(); i++ ) {
+	vector< vector<double> > saliency( frameNum );
+	for ( int i = 0; i < frameNum; i++ ) {
+		saliency[i] = frames[i].superpixelSaliency;
+	}
+
+	/*
+	For a superpixel of frame i the pixel chains reach frame i + dir * j with the mass
+	e^T G_1 ... G_j, so the weighted saliency they collect over all offsets is
+	G_1 (w_1 s_1 + G_2 (w_2 s_2 + ... G_J w_J s_J)). Evaluating that from the far end
+	pulls whole saliency vectors back through each graph once, O(edges * span) per
+	frame, and the same recursion on ones gives the expected number of frames reached.
+	*/
+	vector< vector<double> > smoothedSaliency( frameNum );
+	for ( int i = 0; i < frameNum; i++ ) {
+
+		vector<double> sumSaliency( frames[i].superpixelNum ), frameCount( frames[i].superpixelNum, 1 );
+		for ( int k = 0; k < frames[i].superpixelNum; k++ ) {
+			sumSaliency[k] = smoothWeight[0] * saliency[i][k];
+		}
 
-		Mat smoothedSaliencyMap( frames[i].saliencyMap.size(), CV_32FC1 );
+		for ( int dir = -1; dir <= 1; dir += 2 ) {
 
-		for ( int y = 0; y < size.height; y++ ) {
-			for ( int x = 0; x < size.width; x++ ) {
+			int stepNum = min( frameSpan, (dir < 0) ? i : frameNum - 1 - i );
+			if ( stepNum == 0 ) continue;
 
-				Point2f p( x, y );
-				double sumSaliency = smoothWeight[0] * frames[i].saliencyMap.at<float>( y, x );
-				int frameCount = 1;
+			int farFrame = i + dir * stepNum;
+			vector<double> pulledSaliency( frames[farFrame].superpixelNum ), pulledCount( frames[farFrame].superpixelNum, 1 );
+			for ( int k = 0; k < frames[farFrame].superpixelNum; k++ ) {
+				pulledSaliency[k] = smoothWeight[stepNum] * saliency[farFrame][k];
+			}
 
-				for ( int j = 1; j <= frameSpan; j++ ) {
-					if ( i - j < 0 ) break;
-					Point2f flow = frames[i - j + 1].backwardFlowMap.at<Point2f>( FloorToInt( p.y ), FloorToInt( p.x ) );
-					p.x += flow.x;
-					p.y += flow.y;
-					if ( CheckOutside( p, size ) ) break;
-					sumSaliency += smoothWeight[j] * frames[i - j].saliencyMap.at<float>( FloorToInt( p.y ), FloorToInt( p.x ) );
-					frameCount++;
+			for ( int j = stepNum; j >= 1; j-- ) {
+
+				int curFrame = i + dir * (j - 1);
+				const SuperpixelGraph &graph = (dir < 0) ? backwardGraph[curFrame] : forwardGraph[curFrame];
+				vector<double> curSaliency( frames[curFrame].superpixelNum, 0 ), curCount( frames[curFrame].superpixelNum, 0 );
+
+				for ( int k = 0; k < frames[curFrame].superpixelNum; k++ ) {
+					for ( const auto &link : graph[k] ) {
+						curSaliency[k] += link.second * pulledSaliency[link.first];
+						curCount[k] += link.second * pulledCount[link.first];
+					}
+					if ( j > 1 ) {
+						curSaliency[k] += smoothWeight[j - 1] * saliency[curFrame][k];
+						curCount[k] += 1;
+					}
 				}
 
-				p = Point2f( x, y );
+				pulledSaliency.swap( curSaliency );
+				pulledCount.swap( curCount );
 
-				for ( int j = 1; j <= frameSpan; j++ ) {
-					if ( i + j >= (int)frames.size() ) break;
-					Point2f flow = frames[i + j - 1].forwardFlowMap.at<Point2f>( FloorToInt( p.y ), FloorToInt( p.x ) );
-					p.x += flow.x;
-					p.y += flow.y;
-					if ( CheckOutside( p, size ) ) break;
-					sumSaliency += smoothWeight[j] * frames[i + j].saliencyMap.at<float>( FloorToInt( p.y ), FloorToInt( p.x ) );
-					frameCount++;
-				}
+			}
+
+			for ( int k = 0; k < frames[i].superpixelNum; k++ ) {
+				sumSaliency[k] += pulledSaliency[k];
+				frameCount[k] += pulledCount[k];
+			}
+
+		}
 
-				sumSaliency /= frameCount;
-				smoothedSaliencyMap.at<float>( y, x ) = (float)sumSaliency;
+		// Ratio of the expected sums, the pixel chains average each chain before the superpixel mean.
+		smoothedSaliency[i].resize( frames[i].superpixelNum );
+		for ( int k = 0; k < frames[i].superpixelNum; k++ ) {
+			smoothedSaliency[i][k] = sumSaliency[k] / frameCount[k];
+		}
+		NormalizeVec( smoothedSaliency[i] );
+
+	}
+
+	for ( int i = 0; i < frameNum; i++ ) {
+		frames[i].superpixelSaliency = smoothedSaliency[i];
+	}
+
+#ifdef SMOOTH_SALIENCY_MAP
+	for ( size_t i = 0; i < frames.size(); i++ ) {
+		cout << frames[i].frameId << endl;
+		imshow( "Smoothed Saliency Map", frames[i].GetSaliencyMap() );
+		waitKey( 0 );
+	}
+#endif
+
+}
 
+class SmoothSaliencyByPixelBody : public ParallelLoopBody {
+
+private:
+	const vector<KeyFrame> &frames;
+	const vector<Mat> &saliencyMapVec;
+	const vector<double> &smoothWeight;
+	vector<Mat> &smoothedSaliencyMapVec;
+	int frameSpan, tileNum;
+
+public:
+	SmoothSaliencyByPixelBody( const vector<KeyFrame> &_frames, const vector<Mat> &_saliencyMapVec, const vector<double> &_smoothWeight, vector<Mat> &_smoothedSaliencyMapVec, int _frameSpan, int _tileNum ) :
+		frames( _frames ), saliencyMapVec( _saliencyMapVec ), smoothWeight( _smoothWeight ), smoothedSaliencyMapVec( _smoothedSaliencyMapVec ), frameSpan( _frameSpan ), tileNum( _tileNum ) {}
+
+	// Each task is one row tile of one frame, tiles never share output rows.
+	void operator()( const Range &range ) const {
+
+		int frameNum = frames.size();
+		Size size = frames[0].size;
+
+		for ( int task = range.start; task < range.end; task++ ) {
+
+			int i = task / tileNum;
+			int tileId = task % tileNum;
+			int tileSt = tileId * SALIENCY_SMOOTH_TILE_ROWS;
+			int tileEd = min( size.height, tileSt + SALIENCY_SMOOTH_TILE_ROWS );
+
+			for ( int y = tileSt; y < tileEd; y++ ) {
+
+				const float *saliencyRow = saliencyMapVec[i].ptr<float>( y );
+				float *smoothedRow = smoothedSaliencyMapVec[i].ptr<float>( y );
+
+				for ( int x = 0; x < size.width; x++ ) {
+
+					Point2f p( x, y );
+					int px = x, py = y;
+					double sumSaliency = smoothWeight[0] * saliencyRow[x];
+					int frameCount = 1;
+
+					for ( int j = 1; j <= frameSpan; j++ ) {
+						if ( i - j < 0 ) break;
+						Point2f flow = frames[i - j + 1].backwardFlowMap.ptr<Point2f>( py )[px];
+						p.x += flow.x;
+						p.y += flow.y;
+						if ( CheckOutside( p, size ) ) break;
+						px = FloorToInt( p.x );
+						py = FloorToInt( p.y );
+						sumSaliency += smoothWeight[j] * saliencyMapVec[i - j].ptr<float>( py )[px];
+						frameCount++;
+					}
+
+					p = Point2f( x, y );
+					px = x;
+					py = y;
+
+					for ( int j = 1; j <= frameSpan; j++ ) {
+						if ( i + j >= frameNum ) break;
+						Point2f flow = frames[i + j - 1].forwardFlowMap.ptr<Point2f>( py )[px];
+						p.x += flow.x;
+						p.y += flow.y;
+						if ( CheckOutside( p, size ) ) break;
+						px = FloorToInt( p.x );
+						py = FloorToInt( p.y );
+						sumSaliency += smoothWeight[j] * saliencyMapVec[i + j].ptr<float>( py )[px];
+						frameCount++;
+					}
+
+					sumSaliency /= frameCount;
+					smoothedRow[x] = (float)sumSaliency;
+
+				}
 			}
 		}
 
-		normalize( smoothedSaliencyMap, smoothedSaliencyMap, 0, 1, NORM_MINMAX );
-		smoothedSaliencyMapVec.push_back( smoothedSaliencyMap );
+	}
+
+};
+
+void SmoothSaliencyMapByPixel( vector<KeyFrame> &frames ) {
+
+	vector<Mat> smoothedSaliencyMapVec;
+	SmoothSaliencyMapByPixel( frames, smoothedSaliencyMapVec );
+
+}
+
+void SmoothSaliencyMapByPixel( vector<KeyFrame> &frames, vector<Mat> &smoothedSaliencyMapVec ) {
+
+// #define SMOOTH_SALIENCY_MAP
+	printf( "Smooth key frames saliency map by pixel.\n" );
+
+	int frameSpan = SALIENCY_SMOOTH_SPAN >> 1;
+	int frameNum = frames.size();
+	Size size = frames[0].size;
+	vector<double> smoothWeight;
+	vector<Mat> saliencyMapVec;
+
+	for ( int i = frameSpan; i < SALIENCY_SMOOTH_SPAN; i++ ) {
+		smoothWeight.push_back( exp( -(float)sqr( i - frameSpan ) / sqr( frameSpan ) ) );
+	}
+
+#ifdef SMOOTH_SALIENCY_MAP
+	//cout << frameSpan << endl;
+	//for ( auto x : smoothWeight ) cout << x << endl;
+#endif
+
+	// Materialize the pixel maps up front, the parallel body only reads them.
+	smoothedSaliencyMapVec.clear();
+	for ( int i = 0; i < frameNum; i++ ) {
+		saliencyMapVec.push_back( frames[i].GetSaliencyMap() );
+		smoothedSaliencyMapVec.push_back( Mat( size, CV_32FC1 ) );
+	}
+
+	int tileNum = (size.height + SALIENCY_SMOOTH_TILE_ROWS - 1) / SALIENCY_SMOOTH_TILE_ROWS;
+	parallel_for_( Range( 0, frameNum * tileNum ), SmoothSaliencyByPixelBody( frames, saliencyMapVec, smoothWeight, smoothedSaliencyMapVec, frameSpan, tileNum ) );
 
+	for ( int i = 0; i < frameNum; i++ ) {
+		normalize( smoothedSaliencyMapVec[i], smoothedSaliencyMapVec[i], 0, 1, NORM_MINMAX );
 	}
 
 	for ( size_t i = 0; i < frames.size(); i++ ) {
 #ifdef SMOOTH_SALIENCY_MAP
-		imshow( "saliency map before", frames[i].saliencyMap );
+		imshow( "saliency map before", saliencyMapVec[i] );
 		cout << frames[i].frameId << endl;
 		imshow( "Smoothed Saliency Map", smoothedSaliencyMapVec[i] );
 		waitKey( 0 );
 #endif
-		frames[i].saliencyMap = smoothedSaliencyMapVec[i].clone();
-		frames[i].SumSuperpixelSaliency();
+		frames[i].SumSuperpixelSaliency( smoothedSaliencyMapVec[i] );
 
 	}
 
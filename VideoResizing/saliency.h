@@ -8,8 +8,27 @@ void DrawOpticalFlow( const Mat &, const Mat & );
 
 void CalcMotion( const Mat &, Mat &, Point2f & );
 
+typedef pair<int, double> SuperpixelLink;
+typedef vector< vector<SuperpixelLink> > SuperpixelGraph;
+
+void CalcFlowMap( const Mat &, const Mat &, Mat &, double );
+
+void CalcOpticalFlow( vector<KeyFrame> &, double );
+
+void CalcMotionMap( vector<KeyFrame> & );
+
 void CalcSaliencyMap( vector<KeyFrame> & );
 
+Mat CalcSpectralResidualMap( const Mat & );
+
+void CalcSpectralResidualSaliency( vector<KeyFrame> & );
+
+void CalcSuperpixelGraph( const KeyFrame &, const Mat &, const KeyFrame &, SuperpixelGraph & );
+
 void SmoothSaliencyMap( vector<KeyFrame> & );
 
+void SmoothSaliencyMapByPixel( vector<KeyFrame> & );
+
+void SmoothSaliencyMapByPixel( vector<KeyFrame> &, vector<Mat> & );
+
 #endif
\ No newline at end of file
@@ -27,9 +27,20 @@
 
 #include "slic.h"
 
+#if defined(__AVX__)
+#  include <immintrin.h>
+#  define SLIC_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define SLIC_SIMD_SSE2
+#endif
+
 using namespace cv;
 using namespace std;
 
+// Rows per stripe for the parallel centroid update and connectivity pass
+const int SLIC_STRIPE_ROWS = 32;
+
 // For superpixels
 const int dx4[4] = { -1, 0, 1, 0 };
 const int dy4[4] = { 0, -1, 0, 1 };
@@ -50,44 +61,34 @@ SLIC::SLIC() {
 	m_avec = NULL;
 	m_bvec = NULL;
 
-	m_lvecvec = NULL;
-	m_avecvec = NULL;
-	m_bvecvec = NULL;
-
 	bufferGray = NULL;
 	bufferRGB = NULL;
-}
-
-SLIC::~SLIC() {
-	if ( m_lvec ) delete[] m_lvec;
-	if ( m_avec ) delete[] m_avec;
-	if ( m_bvec ) delete[] m_bvec;
-
-
-	if ( m_lvecvec ) {
-		for ( int d = 0; d < m_depth; d++ ) delete[] m_lvecvec[d];
-		delete[] m_lvecvec;
-	}
-	if ( m_avecvec ) {
-		for ( int d = 0; d < m_depth; d++ ) delete[] m_avecvec[d];
-		delete[] m_avecvec;
-	}
-	if ( m_bvecvec ) {
-		for ( int d = 0; d < m_depth; d++ ) delete[] m_bvecvec[d];
-		delete[] m_bvecvec;
-	}
 
-	if ( bufferGray ) {
-		delete[] bufferGray;
-	}
+	label = NULL;
+	m_numlabels = 0;
+	m_workspace = &m_ownWorkspace;
+	m_supervoxelNum = 0;
+	m_depth = 0;
+
+	simdAssign = true;
+
+	m_warmStart = false;
+	m_initIters = 0;
+	m_initShiftThres = 0;
+	m_shiftThres = 0;
+	m_changeRatio = 0;
+	m_stats.iterations = 0;
+	m_stats.elapsedMs = 0;
+	m_stats.residual = 0;
+	m_stats.labelChanges = 0;
+	m_proxyStep = 0;
+}
 
-	if ( bufferRGB ) {
-		delete[] bufferRGB;
-	}
+SLIC::SLIC( SlicWorkspace& workspace ) : SLIC() {
+	m_workspace = &workspace;
+}
 
-	if ( label ) {
-		delete[] label;
-	}
+SLIC::~SLIC() {
 }
 
 //==============================================================================
@@ -164,20 +165,22 @@ void SLIC::RGB2LAB( const int& sR, const int& sG, const int& sB, double& lval, d
 //===========================================================================
 void SLIC::DoRGBtoLABConversion(
 	const unsigned int*&		ubuff,
-	double*&					lvec,
-	double*&					avec,
-	double*&					bvec ) {
+	float*&						lvec,
+	float*&						avec,
+	float*&						bvec ) {
 	int sz = m_width*m_height;
-	lvec = new double[sz];
-	avec = new double[sz];
-	bvec = new double[sz];
+	AllocatePlanes( sz );
 
 	for ( int j = 0; j < sz; j++ ) {
 		int r = (ubuff[j] >> 16) & 0xFF;
 		int g = (ubuff[j] >> 8) & 0xFF;
 		int b = (ubuff[j]) & 0xFF;
 
-		RGB2LAB( r, g, b, lvec[j], avec[j], bvec[j] );
+		double lval, aval, bval;
+		RGB2LAB( r, g, b, lval, aval, bval );
+		lvec[j] = (float)lval;
+		avec[j] = (float)aval;
+		bvec[j] = (float)bval;
 	}
 }
 
@@ -188,9 +191,9 @@ void SLIC::DoRGBtoLABConversion(
 //===========================================================================
 void SLIC::DoRGBtoLABConversion(
 	const unsigned int**&		ubuff,
-	double**&					lvec,
-	double**&					avec,
-	double**&					bvec ) {
+	float**&					lvec,
+	float**&					avec,
+	float**&					bvec ) {
 	int sz = m_width*m_height;
 	for ( int d = 0; d < m_depth; d++ ) {
 		for ( int j = 0; j < sz; j++ ) {
@@ -198,7 +201,11 @@ void SLIC::DoRGBtoLABConversion(
 			int g = (ubuff[d][j] >> 8) & 0xFF;
 			int b = (ubuff[d][j]) & 0xFF;
 
-			RGB2LAB( r, g, b, lvec[d][j], avec[d][j], bvec[d][j] );
+			double lval, aval, bval;
+			RGB2LAB( r, g, b, lval, aval, bval );
+			lvec[d][j] = (float)lval;
+			avec[d][j] = (float)aval;
+			bvec[d][j] = (float)bval;
 		}
 	}
 }
@@ -368,15 +375,15 @@ void SLIC::DrawContoursAroundSegmentsTwoColors(
 ///	DetectLabEdges
 //==============================================================================
 void SLIC::DetectLabEdges(
-	const double*				lvec,
-	const double*				avec,
-	const double*				bvec,
+	const float*				lvec,
+	const float*				avec,
+	const float*				bvec,
 	const int&					width,
 	const int&					height,
 	vector<double>&				edges ) {
 	int sz = width*height;
 
-	edges.resize( sz, 0 );
+	edges.assign( sz, 0 );
 	for ( int j = 1; j < height - 1; j++ ) {
 		for ( int k = 1; k < width - 1; k++ ) {
 			int i = j*width + k;
@@ -553,6 +560,311 @@ void SLIC::GetLABXYSeeds_ForGivenK(
 }
 
 
+//===========================================================================
+///	AssignWindowRow
+///
+/// Float Lab+xy distance for one row of a seed window. Pixels are read from
+/// the SoA planes 8 (AVX) or 4 (SSE2) at a time, the tail is scalar.
+//===========================================================================
+static void AssignWindowRow(
+	const float*				lrow,
+	const float*				arow,
+	const float*				brow,
+	float*						distlabrow,
+	float*						distxyrow,
+	float*						distvecrow,
+	int*						labelrow,
+	const int					x1,
+	const int					x2,
+	const float					dy2,
+	const float					sl,
+	const float					sa,
+	const float					sb,
+	const float					sx,
+	const float					invlab,
+	const float					invxy,
+	const int					n ) {
+	int x = x1;
+
+#if defined(SLIC_SIMD_AVX)
+	const __m256 vsl = _mm256_set1_ps( sl );
+	const __m256 vsa = _mm256_set1_ps( sa );
+	const __m256 vsb = _mm256_set1_ps( sb );
+	const __m256 vdy2 = _mm256_set1_ps( dy2 );
+	const __m256 vinvlab = _mm256_set1_ps( invlab );
+	const __m256 vinvxy = _mm256_set1_ps( invxy );
+	const __m256 vstep = _mm256_set1_ps( 8.0f );
+	const __m256 vn = _mm256_castsi256_ps( _mm256_set1_epi32( n ) );
+	__m256 vdx = _mm256_sub_ps( _mm256_setr_ps( (float)x, (float)(x + 1), (float)(x + 2), (float)(x + 3),
+		(float)(x + 4), (float)(x + 5), (float)(x + 6), (float)(x + 7) ), _mm256_set1_ps( sx ) );
+
+	for ( ; x + 8 <= x2; x += 8 ) {
+		__m256 dl = _mm256_sub_ps( _mm256_loadu_ps( lrow + x ), vsl );
+		__m256 da = _mm256_sub_ps( _mm256_loadu_ps( arow + x ), vsa );
+		__m256 db = _mm256_sub_ps( _mm256_loadu_ps( brow + x ), vsb );
+		__m256 dlab = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dl, dl ), _mm256_mul_ps( da, da ) ), _mm256_mul_ps( db, db ) );
+		__m256 dxy = _mm256_add_ps( _mm256_mul_ps( vdx, vdx ), vdy2 );
+		__m256 dist = _mm256_add_ps( _mm256_mul_ps( dlab, vinvlab ), _mm256_mul_ps( dxy, vinvxy ) );
+
+		__m256 olddist = _mm256_loadu_ps( distvecrow + x );
+		__m256 mask = _mm256_cmp_ps( dist, olddist, _CMP_LT_OQ );
+		__m256 oldlabel = _mm256_castsi256_ps( _mm256_loadu_si256( (const __m256i*)(labelrow + x) ) );
+
+		_mm256_storeu_ps( distlabrow + x, dlab );
+		_mm256_storeu_ps( distxyrow + x, dxy );
+		_mm256_storeu_ps( distvecrow + x, _mm256_blendv_ps( olddist, dist, mask ) );
+		_mm256_storeu_si256( (__m256i*)(labelrow + x), _mm256_castps_si256( _mm256_blendv_ps( oldlabel, vn, mask ) ) );
+
+		vdx = _mm256_add_ps( vdx, vstep );
+	}
+#elif defined(SLIC_SIMD_SSE2)
+	const __m128 vsl = _mm_set1_ps( sl );
+	const __m128 vsa = _mm_set1_ps( sa );
+	const __m128 vsb = _mm_set1_ps( sb );
+	const __m128 vdy2 = _mm_set1_ps( dy2 );
+	const __m128 vinvlab = _mm_set1_ps( invlab );
+	const __m128 vinvxy = _mm_set1_ps( invxy );
+	const __m128 vstep = _mm_set1_ps( 4.0f );
+	const __m128i vn = _mm_set1_epi32( n );
+	__m128 vdx = _mm_sub_ps( _mm_setr_ps( (float)x, (float)(x + 1), (float)(x + 2), (float)(x + 3) ), _mm_set1_ps( sx ) );
+
+	for ( ; x + 4 <= x2; x += 4 ) {
+		__m128 dl = _mm_sub_ps( _mm_loadu_ps( lrow + x ), vsl );
+		__m128 da = _mm_sub_ps( _mm_loadu_ps( arow + x ), vsa );
+		__m128 db = _mm_sub_ps( _mm_loadu_ps( brow + x ), vsb );
+		__m128 dlab = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dl, dl ), _mm_mul_ps( da, da ) ), _mm_mul_ps( db, db ) );
+		__m128 dxy = _mm_add_ps( _mm_mul_ps( vdx, vdx ), vdy2 );
+		__m128 dist = _mm_add_ps( _mm_mul_ps( dlab, vinvlab ), _mm_mul_ps( dxy, vinvxy ) );
+
+		__m128 olddist = _mm_loadu_ps( distvecrow + x );
+		__m128 mask = _mm_cmplt_ps( dist, olddist );
+		__m128i imask = _mm_castps_si128( mask );
+		__m128i oldlabel = _mm_loadu_si128( (const __m128i*)(labelrow + x) );
+
+		_mm_storeu_ps( distlabrow + x, dlab );
+		_mm_storeu_ps( distxyrow + x, dxy );
+		_mm_storeu_ps( distvecrow + x, _mm_or_ps( _mm_and_ps( mask, dist ), _mm_andnot_ps( mask, olddist ) ) );
+		_mm_storeu_si128( (__m128i*)(labelrow + x), _mm_or_si128( _mm_and_si128( imask, vn ), _mm_andnot_si128( imask, oldlabel ) ) );
+
+		vdx = _mm_add_ps( vdx, vstep );
+	}
+#endif
+
+	for ( ; x < x2; x++ ) {
+		float dl = lrow[x] - sl;
+		float da = arow[x] - sa;
+		float db = brow[x] - sb;
+		float dx = (float)x - sx;
+		float dlab = dl*dl + da*da + db*db;
+		float dxy = dx*dx + dy2;
+		float dist = dlab*invlab + dxy*invxy;
+
+		distlabrow[x] = dlab;
+		distxyrow[x] = dxy;
+		if ( dist < distvecrow[x] ) {
+			distvecrow[x] = dist;
+			labelrow[x] = n;
+		}
+	}
+}
+
+//===========================================================================
+///	SlicAssignBody
+///
+/// One task per seed stripe of a given parity. A stripe is 2*offset rows
+/// high, so windows of seeds in same parity stripes never overlap and
+/// klabels/distvec can be written without locking.
+//===========================================================================
+class SlicAssignBody : public ParallelLoopBody {
+
+private:
+	const float *lvec, *avec, *bvec;
+	const int width, height, offset, phase;
+	const vector<double> &kseedsl, &kseedsa, &kseedsb, &kseedsx, &kseedsy, &maxlab;
+	const vector< vector<int> > &stripeseeds;
+	const float invxywt;
+	float *distlab, *distxy, *distvec;
+	int *klabels;
+
+public:
+	SlicAssignBody( const float *_lvec, const float *_avec, const float *_bvec, int _width, int _height, int _offset, int _phase,
+		const vector<double> &_kseedsl, const vector<double> &_kseedsa, const vector<double> &_kseedsb,
+		const vector<double> &_kseedsx, const vector<double> &_kseedsy, const vector<double> &_maxlab,
+		const vector< vector<int> > &_stripeseeds, float _invxywt, float *_distlab, float *_distxy, float *_distvec, int *_klabels ) :
+		lvec( _lvec ), avec( _avec ), bvec( _bvec ), width( _width ), height( _height ), offset( _offset ), phase( _phase ),
+		kseedsl( _kseedsl ), kseedsa( _kseedsa ), kseedsb( _kseedsb ), kseedsx( _kseedsx ), kseedsy( _kseedsy ), maxlab( _maxlab ),
+		stripeseeds( _stripeseeds ), invxywt( _invxywt ), distlab( _distlab ), distxy( _distxy ), distvec( _distvec ), klabels( _klabels ) {}
+
+	void operator()( const Range &range ) const {
+		for ( int s = range.start; s < range.end; s++ ) {
+			const vector<int> &seeds = stripeseeds[2 * s + phase];
+			for ( size_t k = 0; k < seeds.size(); k++ ) {
+				int n = seeds[k];
+				int y1 = std::max( 0, (int)(kseedsy[n] - offset) );
+				int y2 = std::min( height, (int)(kseedsy[n] + offset) );
+				int x1 = std::max( 0, (int)(kseedsx[n] - offset) );
+				int x2 = std::min( width, (int)(kseedsx[n] + offset) );
+
+				const float invlab = (float)(1.0 / maxlab[n]);
+				for ( int y = y1; y < y2; y++ ) {
+					int rowindex = y*width;
+					float dy = (float)y - (float)kseedsy[n];
+					AssignWindowRow( lvec + rowindex, avec + rowindex, bvec + rowindex,
+						distlab + rowindex, distxy + rowindex, distvec + rowindex, klabels + rowindex,
+						x1, x2, dy*dy, (float)kseedsl[n], (float)kseedsa[n], (float)kseedsb[n], (float)kseedsx[n],
+						invlab, invxywt, n );
+				}
+			}
+		}
+	}
+
+};
+
+//===========================================================================
+///	SlicUpdateBody
+///
+/// Per row stripe partial sums for the centroids and partial maxima for
+/// maxlab/maxxy. Stripes are fixed by SLIC_STRIPE_ROWS, not by the thread
+/// count, so the merged result is the same for any number of threads.
+//===========================================================================
+class SlicUpdateBody : public ParallelLoopBody {
+
+private:
+	const float *lvec, *avec, *bvec, *distlab, *distxy;
+	const int *klabels, *prevlabels;
+	const int width, height, numk;
+	vector<SlicPartial> &partials;
+
+public:
+	SlicUpdateBody( const float *_lvec, const float *_avec, const float *_bvec, const float *_distlab, const float *_distxy,
+		const int *_klabels, const int *_prevlabels, int _width, int _height, int _numk, vector<SlicPartial> &_partials ) :
+		lvec( _lvec ), avec( _avec ), bvec( _bvec ), distlab( _distlab ), distxy( _distxy ),
+		klabels( _klabels ), prevlabels( _prevlabels ), width( _width ), height( _height ), numk( _numk ), partials( _partials ) {}
+
+	void operator()( const Range &range ) const {
+		for ( int s = range.start; s < range.end; s++ ) {
+			SlicPartial &partial = partials[s];
+			partial.sigmal.assign( numk, 0 );
+			partial.sigmaa.assign( numk, 0 );
+			partial.sigmab.assign( numk, 0 );
+			partial.sigmax.assign( numk, 0 );
+			partial.sigmay.assign( numk, 0 );
+			partial.maxlab.assign( numk, 0 );
+			partial.maxxy.assign( numk, 0 );
+			partial.clustersize.assign( numk, 0 );
+			partial.labelchanges = 0;
+
+			int y2 = std::min( height, (s + 1) * SLIC_STRIPE_ROWS );
+			for ( int y = s * SLIC_STRIPE_ROWS; y < y2; y++ ) {
+				for ( int x = 0; x < width; x++ ) {
+					int j = y*width + x;
+					int k = klabels[j];
+					_ASSERT( k >= 0 );
+					if ( partial.maxlab[k] < distlab[j] ) partial.maxlab[k] = distlab[j];
+					if ( partial.maxxy[k] < distxy[j] ) partial.maxxy[k] = distxy[j];
+					partial.sigmal[k] += lvec[j];
+					partial.sigmaa[k] += avec[j];
+					partial.sigmab[k] += bvec[j];
+					partial.sigmax[k] += x;
+					partial.sigmay[k] += y;
+					partial.clustersize[k]++;
+					if ( k != prevlabels[j] ) partial.labelchanges++;
+				}
+			}
+		}
+	}
+
+};
+
+//===========================================================================
+///	SlicRefineBody
+///
+/// Boundary refinement of the proxy path, one task per row range. Pixels
+/// whose label equals the labels radius away in all eight directions keep
+/// it; the others take the closest center among the labels in the window.
+//===========================================================================
+class SlicRefineBody : public ParallelLoopBody {
+
+private:
+	const cv::Mat &labImg;
+	const int *coarse;
+	cv::Mat &labelMat;
+	const int radius;
+	const double invxywt;
+	vector<double> cl, ca, cb, cx, cy, invlab;
+
+	static const int MAX_CANDIDATES = 8;
+
+public:
+	SlicRefineBody( const cv::Mat &_labImg, const int *_coarse, cv::Mat &_labelMat, int _radius, double _invxywt,
+		const SlicSeeds &seeds, const vector<double> &maxlab, const vector<int> &seedOfLabel ) :
+		labImg( _labImg ), coarse( _coarse ), labelMat( _labelMat ), radius( _radius ), invxywt( _invxywt ) {
+		// Centers indexed by label instead of seed
+		int numlabels = seedOfLabel.size();
+		cl.resize( numlabels ); ca.resize( numlabels ); cb.resize( numlabels );
+		cx.resize( numlabels ); cy.resize( numlabels ); invlab.resize( numlabels );
+		for ( int k = 0; k < numlabels; k++ ) {
+			int n = std::max( seedOfLabel[k], 0 );
+			cl[k] = seeds.l[n]; ca[k] = seeds.a[n]; cb[k] = seeds.b[n];
+			cx[k] = seeds.x[n]; cy[k] = seeds.y[n];
+			invlab[k] = 1.0 / std::max( maxlab[n], 1e-6 );
+		}
+	}
+
+	void operator()( const Range &range ) const {
+		int width = labImg.cols;
+		int height = labImg.rows;
+		int candidates[MAX_CANDIDATES];
+
+		for ( int y = range.start; y < range.end; y++ ) {
+			const cv::Vec3f *labrow = labImg.ptr<cv::Vec3f>( y );
+			int *labelrow = labelMat.ptr<int>( y );
+			int y1 = std::max( 0, y - radius );
+			int y2 = std::min( height - 1, y + radius );
+
+			for ( int x = 0; x < width; x++ ) {
+				int c = coarse[y*width + x];
+				int x1 = std::max( 0, x - radius );
+				int x2 = std::min( width - 1, x + radius );
+
+				if ( coarse[y1*width + x1] == c && coarse[y1*width + x] == c && coarse[y1*width + x2] == c &&
+					coarse[y*width + x1] == c && coarse[y*width + x2] == c &&
+					coarse[y2*width + x1] == c && coarse[y2*width + x] == c && coarse[y2*width + x2] == c ) {
+					labelrow[x] = c;
+					continue;
+				}
+
+				int candidatenum = 0;
+				for ( int yy = y1; yy <= y2; yy++ ) {
+					for ( int xx = x1; xx <= x2; xx++ ) {
+						int k = coarse[yy*width + xx];
+						bool found = false;
+						for ( int t = 0; t < candidatenum; t++ ) {
+							if ( candidates[t] == k ) found = true;
+						}
+						if ( !found && candidatenum < MAX_CANDIDATES ) candidates[candidatenum++] = k;
+					}
+				}
+
+				double l = labrow[x][0], a = labrow[x][1], b = labrow[x][2];
+				int best = c;
+				double bestdist = DBL_MAX;
+				for ( int t = 0; t < candidatenum; t++ ) {
+					int k = candidates[t];
+					double dist = ((l - cl[k])*(l - cl[k]) + (a - ca[k])*(a - ca[k]) + (b - cb[k])*(b - cb[k])) * invlab[k] +
+						((x - cx[k])*(x - cx[k]) + (y - cy[k])*(y - cy[k])) * invxywt;
+					if ( dist < bestdist || (dist == bestdist && k == c) ) {
+						bestdist = dist;
+						best = k;
+					}
+				}
+				labelrow[x] = best;
+			}
+		}
+	}
+
+};
+
 //===========================================================================
 ///	PerformSuperpixelSegmentation_VariableSandM
 ///
@@ -570,6 +882,10 @@ void SLIC::GetLABXYSeeds_ForGivenK(
 ///
 /// SLICO (or SLIC Zero) dynamically varies only the compactness factor S,
 /// not the step size S.
+///
+/// Runs at most NUMITR iterations and stops earlier once every nonzero
+/// threshold is met: mean center shift below shiftThres pixels, at most
+/// changeRatio of the pixels switched cluster. Counters go to m_stats.
 //===========================================================================
 void SLIC::PerformSuperpixelSegmentation_VariableSandM(
 	vector<double>&				kseedsl,
@@ -579,11 +895,13 @@ void SLIC::PerformSuperpixelSegmentation_VariableSandM(
 	vector<double>&				kseedsy,
 	int*						klabels,
 	const int&					STEP,
-	const int&					NUMITR ) {
+	const int&					NUMITR,
+	const double&				shiftThres,
+	const double&				changeRatio ) {
 	int sz = m_width*m_height;
 	const int numk = kseedsl.size();
-	//double cumerr(99999.9);
 	int numitr( 0 );
+	int64 starttick = cv::getTickCount();
 
 	//----------------
 	int offset = STEP;
@@ -597,51 +915,93 @@ void SLIC::PerformSuperpixelSegmentation_VariableSandM(
 	vector<double> sigmay( numk, 0 );
 	vector<int> clustersize( numk, 0 );
 	vector<double> inv( numk, 0 );//to store 1/clustersize[k] values
-	vector<double> distxy( sz, DBL_MAX );
-	vector<double> distlab( sz, DBL_MAX );
-	vector<double> distvec( sz, DBL_MAX );
+	vector<double> distxy( simdAssign ? 0 : sz, DBL_MAX );
+	vector<double> distlab( simdAssign ? 0 : sz, DBL_MAX );
+	vector<double> distvec( simdAssign ? 0 : sz, DBL_MAX );
 	vector<double> maxlab( numk, 10 * 10 );//THIS IS THE VARIABLE VALUE OF M, just start with 10
 	vector<double> maxxy( numk, STEP*STEP );//THIS IS THE VARIABLE VALUE OF M, just start with 10
 
 	double invxywt = 1.0 / (STEP*STEP);//NOTE: this is different from how usual SLIC/LKM works
 
+	//--------------------------------------------------------------------------
+	// Float buffers for the SoA kernel, the double ones above for the reference
+	//--------------------------------------------------------------------------
+	vector<float>& fdistxy = m_workspace->distxy;
+	vector<float>& fdistlab = m_workspace->distlab;
+	vector<float>& fdistvec = m_workspace->distvec;
+	if ( simdAssign ) {
+		fdistxy.assign( sz, FLT_MAX );
+		fdistlab.assign( sz, FLT_MAX );
+	}
+
+	//--------------------------------------------------------------------------
+	// Labels of the previous iteration, to count the pixels that moved
+	//--------------------------------------------------------------------------
+	vector<int>& prevlabels = m_workspace->prevlabels;
+	prevlabels.resize( sz );
+	int labelchanges( 0 );
+	double shift( 0 );
+
 	while ( numitr < NUMITR ) {
 		//------
-		//cumerr = 0;
 		numitr++;
+		labelchanges = 0;
+		std::copy( klabels, klabels + sz, prevlabels.begin() );
 		//------
 
-		distvec.assign( sz, DBL_MAX );
-		for ( int n = 0; n < numk; n++ ) {
-			int y1 = std::max( 0, (int)(kseedsy[n] - offset) );
-			int y2 = std::min( m_height, (int)(kseedsy[n] + offset) );
-			int x1 = std::max( 0, (int)(kseedsx[n] - offset) );
-			int x2 = std::min( m_width, (int)(kseedsx[n] + offset) );
-
-			for ( int y = y1; y < y2; y++ ) {
-				for ( int x = x1; x < x2; x++ ) {
-					int i = y*m_width + x;
-					_ASSERT( y < m_height && x < m_width && y >= 0 && x >= 0 );
-
-					double l = m_lvec[i];
-					double a = m_avec[i];
-					double b = m_bvec[i];
-
-					distlab[i] = (l - kseedsl[n])*(l - kseedsl[n]) +
-						(a - kseedsa[n])*(a - kseedsa[n]) +
-						(b - kseedsb[n])*(b - kseedsb[n]);
-
-					distxy[i] = (x - kseedsx[n])*(x - kseedsx[n]) +
-						(y - kseedsy[n])*(y - kseedsy[n]);
-
-					//------------------------------------------------------------------------
-					double dist = distlab[i] / maxlab[n] + distxy[i] * invxywt;//only varying m, prettier superpixels
-					//double dist = distlab[i]/maxlab[n] + distxy[i]/maxxy[n];//varying both m and S
-					//------------------------------------------------------------------------
+		if ( simdAssign ) {
+			//-----------------------------------------------------------------
+			// Seeds grouped in stripes, even stripes first and then odd ones
+			//-----------------------------------------------------------------
+			int stripeheight = 2 * offset;
+			int stripenum = (m_height + stripeheight - 1) / stripeheight;
+			vector< vector<int> >& stripeseeds = m_workspace->stripeseeds;
+			if ( (int)stripeseeds.size() < stripenum ) stripeseeds.resize( stripenum );
+			for ( int s = 0; s < stripenum; s++ ) stripeseeds[s].clear();
+			for ( int n = 0; n < numk; n++ ) {
+				int s = std::min( stripenum - 1, std::max( 0, (int)kseedsy[n] / stripeheight ) );
+				stripeseeds[s].push_back( n );
+			}
 
-					if ( dist < distvec[i] ) {
-						distvec[i] = dist;
-						klabels[i] = n;
+			fdistvec.assign( sz, FLT_MAX );
+			for ( int phase = 0; phase < 2; phase++ ) {
+				parallel_for_( Range( 0, (stripenum + 1 - phase) / 2 ), SlicAssignBody( m_lvec, m_avec, m_bvec, m_width, m_height, offset, phase,
+					kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, maxlab, stripeseeds, (float)invxywt,
+					&fdistlab[0], &fdistxy[0], &fdistvec[0], klabels ) );
+			}
+		} else {
+			distvec.assign( sz, DBL_MAX );
+			for ( int n = 0; n < numk; n++ ) {
+				int y1 = std::max( 0, (int)(kseedsy[n] - offset) );
+				int y2 = std::min( m_height, (int)(kseedsy[n] + offset) );
+				int x1 = std::max( 0, (int)(kseedsx[n] - offset) );
+				int x2 = std::min( m_width, (int)(kseedsx[n] + offset) );
+
+				for ( int y = y1; y < y2; y++ ) {
+					for ( int x = x1; x < x2; x++ ) {
+						int i = y*m_width + x;
+						_ASSERT( y < m_height && x < m_width && y >= 0 && x >= 0 );
+
+						double l = m_lvec[i];
+						double a = m_avec[i];
+						double b = m_bvec[i];
+
+						distlab[i] = (l - kseedsl[n])*(l - kseedsl[n]) +
+							(a - kseedsa[n])*(a - kseedsa[n]) +
+							(b - kseedsb[n])*(b - kseedsb[n]);
+
+						distxy[i] = (x - kseedsx[n])*(x - kseedsx[n]) +
+							(y - kseedsy[n])*(y - kseedsy[n]);
+
+						//------------------------------------------------------------------------
+						double dist = distlab[i] / maxlab[n] + distxy[i] * invxywt;//only varying m, prettier superpixels
+						//double dist = distlab[i]/maxlab[n] + distxy[i]/maxxy[n];//varying both m and S
+						//------------------------------------------------------------------------
+
+						if ( dist < distvec[i] ) {
+							distvec[i] = dist;
+							klabels[i] = n;
+						}
 					}
 				}
 			}
@@ -653,12 +1013,9 @@ void SLIC::PerformSuperpixelSegmentation_VariableSandM(
 			maxlab.assign( numk, 1 );
 			maxxy.assign( numk, 1 );
 		}
-		{for ( int i = 0; i < sz; i++ ) {
-			if ( maxlab[klabels[i]] < distlab[i] ) maxlab[klabels[i]] = distlab[i];
-			if ( maxxy[klabels[i]] < distxy[i] ) maxxy[klabels[i]] = distxy[i];
-		}}
 		//-----------------------------------------------------------------
-		// Recalculate the centroid and store in the seed values
+		// Update the max distances and recalculate the centroid in one
+		// pass, then store the centroid in the seed values
 		//-----------------------------------------------------------------
 		sigmal.assign( numk, 0 );
 		sigmaa.assign( numk, 0 );
@@ -667,16 +1024,43 @@ void SLIC::PerformSuperpixelSegmentation_VariableSandM(
 		sigmay.assign( numk, 0 );
 		clustersize.assign( numk, 0 );
 
-		for ( int j = 0; j < sz; j++ ) {
-			int temp = klabels[j];
-			_ASSERT( klabels[j] >= 0 );
-			sigmal[klabels[j]] += m_lvec[j];
-			sigmaa[klabels[j]] += m_avec[j];
-			sigmab[klabels[j]] += m_bvec[j];
-			sigmax[klabels[j]] += (j%m_width);
-			sigmay[klabels[j]] += (j / m_width);
-
-			clustersize[klabels[j]]++;
+		if ( simdAssign ) {
+			int stripenum = (m_height + SLIC_STRIPE_ROWS - 1) / SLIC_STRIPE_ROWS;
+			vector<SlicPartial>& partials = m_workspace->partials;
+			if ( (int)partials.size() < stripenum ) partials.resize( stripenum );
+			parallel_for_( Range( 0, stripenum ), SlicUpdateBody( m_lvec, m_avec, m_bvec, &fdistlab[0], &fdistxy[0], klabels, &prevlabels[0], m_width, m_height, numk, partials ) );
+
+			for ( int s = 0; s < stripenum; s++ ) {
+				for ( int k = 0; k < numk; k++ ) {
+					if ( maxlab[k] < partials[s].maxlab[k] ) maxlab[k] = partials[s].maxlab[k];
+					if ( maxxy[k] < partials[s].maxxy[k] ) maxxy[k] = partials[s].maxxy[k];
+					sigmal[k] += partials[s].sigmal[k];
+					sigmaa[k] += partials[s].sigmaa[k];
+					sigmab[k] += partials[s].sigmab[k];
+					sigmax[k] += partials[s].sigmax[k];
+					sigmay[k] += partials[s].sigmay[k];
+					clustersize[k] += partials[s].clustersize[k];
+				}
+				labelchanges += partials[s].labelchanges;
+			}
+		} else {
+			for ( int i = 0; i < sz; i++ ) {
+				if ( maxlab[klabels[i]] < distlab[i] ) maxlab[klabels[i]] = distlab[i];
+				if ( maxxy[klabels[i]] < distxy[i] ) maxxy[klabels[i]] = distxy[i];
+			}
+
+			for ( int j = 0; j < sz; j++ ) {
+				int temp = klabels[j];
+				_ASSERT( klabels[j] >= 0 );
+				sigmal[klabels[j]] += m_lvec[j];
+				sigmaa[klabels[j]] += m_avec[j];
+				sigmab[klabels[j]] += m_bvec[j];
+				sigmax[klabels[j]] += (j%m_width);
+				sigmay[klabels[j]] += (j / m_width);
+
+				clustersize[klabels[j]]++;
+				if ( klabels[j] != prevlabels[j] ) labelchanges++;
+			}
 		}
 
 		{for ( int k = 0; k < numk; k++ ) {
@@ -685,13 +1069,215 @@ void SLIC::PerformSuperpixelSegmentation_VariableSandM(
 			inv[k] = 1.0 / double( clustersize[k] );//computing inverse now to multiply, than divide later
 		}}
 
+		shift = 0;
 		{for ( int k = 0; k < numk; k++ ) {
+			double nx = sigmax[k] * inv[k];
+			double ny = sigmay[k] * inv[k];
+			shift += sqrt( (nx - kseedsx[k])*(nx - kseedsx[k]) + (ny - kseedsy[k])*(ny - kseedsy[k]) );
+
 			kseedsl[k] = sigmal[k] * inv[k];
 			kseedsa[k] = sigmaa[k] * inv[k];
 			kseedsb[k] = sigmab[k] * inv[k];
-			kseedsx[k] = sigmax[k] * inv[k];
-			kseedsy[k] = sigmay[k] * inv[k];
+			kseedsx[k] = nx;
+			kseedsy[k] = ny;
 		}}
+
+		//-----------------------------------------------------------------
+		// Stop early once the seeds and the labels have settled
+		//-----------------------------------------------------------------
+		if ( numk > 0 ) shift /= numk;
+		if ( (shiftThres > 0 || changeRatio > 0) &&
+			(shiftThres <= 0 || shift < shiftThres) &&
+			(changeRatio <= 0 || labelchanges <= changeRatio * sz) ) break;
+	}
+
+	m_stats.iterations = numitr;
+	m_stats.elapsedMs = (cv::getTickCount() - starttick) * 1000.0 / cv::getTickFrequency();
+	m_stats.residual = shift;
+	m_stats.labelChanges = labelchanges;
+	m_maxlab = maxlab;
+}
+
+//===========================================================================
+///	SupervoxelAssignBody
+///
+/// One task per frame of the volume; every frame owns its own distance and
+/// label buffers, so seeds can be swept in order without any locking.
+//===========================================================================
+class SupervoxelAssignBody : public ParallelLoopBody {
+
+private:
+	float **lvecvec, **avecvec, **bvecvec;
+	const int width, height, offset, zoffset;
+	const double zscale;
+	const vector<double> &kseedsl, &kseedsa, &kseedsb, &kseedsx, &kseedsy, &kseedsz, &maxlab;
+	const float invxywt;
+	vector< vector<float> > &distlab, &distxy, &distvec;
+	int **klabels;
+
+public:
+	SupervoxelAssignBody( float **_lvecvec, float **_avecvec, float **_bvecvec, int _width, int _height, int _offset, int _zoffset, double _zscale,
+		const vector<double> &_kseedsl, const vector<double> &_kseedsa, const vector<double> &_kseedsb,
+		const vector<double> &_kseedsx, const vector<double> &_kseedsy, const vector<double> &_kseedsz, const vector<double> &_maxlab,
+		float _invxywt, vector< vector<float> > &_distlab, vector< vector<float> > &_distxy, vector< vector<float> > &_distvec, int **_klabels ) :
+		lvecvec( _lvecvec ), avecvec( _avecvec ), bvecvec( _bvecvec ), width( _width ), height( _height ), offset( _offset ), zoffset( _zoffset ), zscale( _zscale ),
+		kseedsl( _kseedsl ), kseedsa( _kseedsa ), kseedsb( _kseedsb ), kseedsx( _kseedsx ), kseedsy( _kseedsy ), kseedsz( _kseedsz ), maxlab( _maxlab ),
+		invxywt( _invxywt ), distlab( _distlab ), distxy( _distxy ), distvec( _distvec ), klabels( _klabels ) {}
+
+	void operator()( const Range &range ) const {
+		for ( int d = range.start; d < range.end; d++ ) {
+			distvec[d].assign( width*height, FLT_MAX );
+			for ( size_t n = 0; n < kseedsl.size(); n++ ) {
+				if ( d < (int)(kseedsz[n] - zoffset) || d >= (int)(kseedsz[n] + zoffset) ) continue;
+
+				int y1 = std::max( 0, (int)(kseedsy[n] - offset) );
+				int y2 = std::min( height, (int)(kseedsy[n] + offset) );
+				int x1 = std::max( 0, (int)(kseedsx[n] - offset) );
+				int x2 = std::min( width, (int)(kseedsx[n] + offset) );
+
+				const float invlab = (float)(1.0 / maxlab[n]);
+				const float dz = (float)((d - kseedsz[n]) * zscale);
+				for ( int y = y1; y < y2; y++ ) {
+					int rowindex = y*width;
+					float dy = (float)y - (float)kseedsy[n];
+					AssignWindowRow( lvecvec[d] + rowindex, avecvec[d] + rowindex, bvecvec[d] + rowindex,
+						&distlab[d][rowindex], &distxy[d][rowindex], &distvec[d][rowindex], klabels[d] + rowindex,
+						x1, x2, dy*dy + dz*dz, (float)kseedsl[n], (float)kseedsa[n], (float)kseedsb[n], (float)kseedsx[n],
+						invlab, invxywt, (int)n );
+				}
+			}
+		}
+	}
+
+};
+
+//===========================================================================
+///	SupervoxelUpdateBody
+///
+/// Per frame partial sums and maxima, merged in frame order afterwards.
+//===========================================================================
+class SupervoxelUpdateBody : public ParallelLoopBody {
+
+private:
+	float **lvecvec, **avecvec, **bvecvec;
+	const vector< vector<float> > &distlab, &distxy;
+	int **klabels;
+	const int width, height, numk;
+	vector<SlicPartial> &partials;
+
+public:
+	SupervoxelUpdateBody( float **_lvecvec, float **_avecvec, float **_bvecvec, const vector< vector<float> > &_distlab, const vector< vector<float> > &_distxy,
+		int **_klabels, int _width, int _height, int _numk, vector<SlicPartial> &_partials ) :
+		lvecvec( _lvecvec ), avecvec( _avecvec ), bvecvec( _bvecvec ), distlab( _distlab ), distxy( _distxy ),
+		klabels( _klabels ), width( _width ), height( _height ), numk( _numk ), partials( _partials ) {}
+
+	void operator()( const Range &range ) const {
+		for ( int d = range.start; d < range.end; d++ ) {
+			SlicPartial &partial = partials[d];
+			partial.sigmal.assign( numk, 0 );
+			partial.sigmaa.assign( numk, 0 );
+			partial.sigmab.assign( numk, 0 );
+			partial.sigmax.assign( numk, 0 );
+			partial.sigmay.assign( numk, 0 );
+			partial.maxlab.assign( numk, 0 );
+			partial.maxxy.assign( numk, 0 );
+			partial.clustersize.assign( numk, 0 );
+
+			for ( int y = 0; y < height; y++ ) {
+				for ( int x = 0; x < width; x++ ) {
+					int j = y*width + x;
+					int k = klabels[d][j];
+					_ASSERT( k >= 0 );
+					if ( partial.maxlab[k] < distlab[d][j] ) partial.maxlab[k] = distlab[d][j];
+					if ( partial.maxxy[k] < distxy[d][j] ) partial.maxxy[k] = distxy[d][j];
+					partial.sigmal[k] += lvecvec[d][j];
+					partial.sigmaa[k] += avecvec[d][j];
+					partial.sigmab[k] += bvecvec[d][j];
+					partial.sigmax[k] += x;
+					partial.sigmay[k] += y;
+					partial.clustersize[k]++;
+				}
+			}
+		}
+	}
+
+};
+
+//===========================================================================
+///	PerformSupervoxelSegmentation
+///
+/// SLICO over the keyframe stack. The z distance is scaled so that ZSTEP
+/// frames weigh as much as STEP pixels.
+//===========================================================================
+void SLIC::PerformSupervoxelSegmentation(
+	vector<double>&				kseedsl,
+	vector<double>&				kseedsa,
+	vector<double>&				kseedsb,
+	vector<double>&				kseedsx,
+	vector<double>&				kseedsy,
+	vector<double>&				kseedsz,
+	int**						klabels,
+	const int&					STEP,
+	const int&					ZSTEP,
+	const int&					NUMITR ) {
+	int sz = m_width*m_height;
+	const int numk = kseedsl.size();
+
+	int offset = STEP;
+	if ( STEP < 10 ) offset = STEP*1.5;
+
+	vector<double> maxlab( numk, 10 * 10 );
+	vector<double> maxxy( numk, STEP*STEP );
+	double invxywt = 1.0 / (STEP*STEP);
+	double zscale = double( STEP ) / double( ZSTEP );
+
+	vector< vector<float> > &distlab = m_workspace->voxeldistlab;
+	vector< vector<float> > &distxy = m_workspace->voxeldistxy;
+	vector< vector<float> > &distvec = m_workspace->voxeldistvec;
+	distlab.resize( m_depth );
+	distxy.resize( m_depth );
+	distvec.resize( m_depth );
+	for ( int d = 0; d < m_depth; d++ ) {
+		distlab[d].assign( sz, FLT_MAX );
+		distxy[d].assign( sz, FLT_MAX );
+	}
+
+	vector<SlicPartial> &partials = m_workspace->partials;
+	if ( (int)partials.size() < m_depth ) partials.resize( m_depth );
+
+	for ( int numitr = 0; numitr < NUMITR; numitr++ ) {
+		parallel_for_( Range( 0, m_depth ), SupervoxelAssignBody( &m_lvecvec[0], &m_avecvec[0], &m_bvecvec[0], m_width, m_height, offset, ZSTEP, zscale,
+			kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, kseedsz, maxlab, (float)invxywt, distlab, distxy, distvec, klabels ) );
+
+		parallel_for_( Range( 0, m_depth ), SupervoxelUpdateBody( &m_lvecvec[0], &m_avecvec[0], &m_bvecvec[0], distlab, distxy, klabels, m_width, m_height, numk, partials ) );
+
+		vector<double> sigmal( numk, 0 ), sigmaa( numk, 0 ), sigmab( numk, 0 );
+		vector<double> sigmax( numk, 0 ), sigmay( numk, 0 ), sigmaz( numk, 0 );
+		vector<int> clustersize( numk, 0 );
+		for ( int d = 0; d < m_depth; d++ ) {
+			for ( int k = 0; k < numk; k++ ) {
+				if ( maxlab[k] < partials[d].maxlab[k] ) maxlab[k] = partials[d].maxlab[k];
+				if ( maxxy[k] < partials[d].maxxy[k] ) maxxy[k] = partials[d].maxxy[k];
+				sigmal[k] += partials[d].sigmal[k];
+				sigmaa[k] += partials[d].sigmaa[k];
+				sigmab[k] += partials[d].sigmab[k];
+				sigmax[k] += partials[d].sigmax[k];
+				sigmay[k] += partials[d].sigmay[k];
+				sigmaz[k] += (double)d * partials[d].clustersize[k];
+				clustersize[k] += partials[d].clustersize[k];
+			}
+		}
+
+		for ( int k = 0; k < numk; k++ ) {
+			if ( clustersize[k] <= 0 ) continue;//keep seeds that lost all their voxels
+			double inv = 1.0 / double( clustersize[k] );
+			kseedsl[k] = sigmal[k] * inv;
+			kseedsa[k] = sigmaa[k] * inv;
+			kseedsb[k] = sigmab[k] * inv;
+			kseedsx[k] = sigmax[k] * inv;
+			kseedsy[k] = sigmay[k] * inv;
+			kseedsz[k] = sigmaz[k] * inv;
+		}
 	}
 }
 
@@ -722,12 +1308,72 @@ void SLIC::SaveSuperpixelLabels(
 	outfile.close();
 }
 
+//===========================================================================
+///	FindRoot / UnionRoots
+///
+/// Union-find over pixel indices where the root of a set is always its
+/// smallest index, so parent[i] <= i holds throughout.
+//===========================================================================
+static int FindRoot( int* parent, int i ) {
+	while ( parent[i] != i ) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+static void UnionRoots( int* parent, int i, int j ) {
+	i = FindRoot( parent, i );
+	j = FindRoot( parent, j );
+	if ( i < j ) parent[j] = i;
+	else if ( j < i ) parent[i] = j;
+}
+
+//===========================================================================
+///	ConnectivityUnionBody
+///
+/// Joins 4-connected pixels with equal labels inside each row stripe.
+/// Unions never leave the stripe, the stripes are stitched afterwards.
+//===========================================================================
+class ConnectivityUnionBody : public ParallelLoopBody {
+
+private:
+	const int *labels;
+	const int width, height;
+	int *parent;
+
+public:
+	ConnectivityUnionBody( const int *_labels, int _width, int _height, int *_parent ) :
+		labels( _labels ), width( _width ), height( _height ), parent( _parent ) {}
+
+	void operator()( const Range &range ) const {
+		for ( int s = range.start; s < range.end; s++ ) {
+			int y1 = s * SLIC_STRIPE_ROWS;
+			int y2 = std::min( height, y1 + SLIC_STRIPE_ROWS );
+			for ( int y = y1; y < y2; y++ ) {
+				for ( int x = 0; x < width; x++ ) {
+					int i = y*width + x;
+					parent[i] = i;
+					if ( x > 0 && labels[i - 1] == labels[i] ) UnionRoots( parent, i - 1, i );
+					if ( y > y1 && labels[i - width] == labels[i] ) UnionRoots( parent, i - width, i );
+				}
+			}
+		}
+	}
+
+};
+
 //===========================================================================
 ///	EnforceLabelConnectivity
 ///
 ///		1. finding an adjacent label for each new component at the start
 ///		2. if a certain component is too small, assigning the previously found
 ///		    adjacent label to this component, and not incrementing the label.
+///
+/// Components are found with a stripe parallel union-find. Visiting the
+/// component roots in raster order then gives the same labels as the
+/// original flood fill: a neighbour was already labelled by the flood fill
+/// exactly when its root comes before the current one.
 //===========================================================================
 void SLIC::EnforceLabelConnectivity(
 	const int*					labels,//input labels that need to be corrected to remove stray labels
@@ -737,81 +1383,153 @@ void SLIC::EnforceLabelConnectivity(
 	int&						numlabels,//the number of labels changes in the end if segments are removed
 	const int&					K ) //the number of superpixels desired by the user
 {
-	//	const int dx8[8] = {-1, -1,  0,  1, 1, 1, 0, -1};
-	//	const int dy8[8] = { 0, -1, -1, -1, 0, 1, 1,  1};
-
 	const int dx4[4] = { -1, 0, 1, 0 };
 	const int dy4[4] = { 0, -1, 0, 1 };
 
 	const int sz = width*height;
 	const int SUPSZ = sz / K;
-	//nlabels.resize(sz, -1);
-	for ( int i = 0; i < sz; i++ ) nlabels[i] = -1;
+
+	//------------------------------------------------------------
+	// Union inside stripes in parallel, then across stripe seams
+	//------------------------------------------------------------
+	vector<int>& parent = m_workspace->parent;
+	parent.resize( sz );
+	int stripenum = (height + SLIC_STRIPE_ROWS - 1) / SLIC_STRIPE_ROWS;
+	parallel_for_( Range( 0, stripenum ), ConnectivityUnionBody( labels, width, height, &parent[0] ) );
+
+	for ( int y = SLIC_STRIPE_ROWS; y < height; y += SLIC_STRIPE_ROWS ) {
+		for ( int x = 0; x < width; x++ ) {
+			int i = y*width + x;
+			if ( labels[i - width] == labels[i] ) UnionRoots( &parent[0], i - width, i );
+		}
+	}
+
+	//------------------------------------------------------------
+	// Flatten in raster order (parents come first) and count sizes
+	//------------------------------------------------------------
+	vector<int>& segsize = m_workspace->segsize;
+	segsize.assign( sz, 0 );
+	for ( int i = 0; i < sz; i++ ) {
+		parent[i] = parent[parent[i]];
+		segsize[parent[i]]++;
+	}
+
+	//------------------------------------------------------------
+	// Number the components in the order the flood fill met them
+	//------------------------------------------------------------
+	vector<int>& seglabel = m_workspace->seglabel;
+	seglabel.assign( sz, -1 );
 	int label( 0 );
-	int* xvec = new int[sz];
-	int* yvec = new int[sz];
-	int oindex( 0 );
 	int adjlabel( 0 );//adjacent label
+	int oindex( 0 );
 	for ( int j = 0; j < height; j++ ) {
 		for ( int k = 0; k < width; k++ ) {
-			if ( 0 > nlabels[oindex] ) {
-				nlabels[oindex] = label;
-				//--------------------
-				// Start a new segment
-				//--------------------
-				xvec[0] = k;
-				yvec[0] = j;
+			if ( parent[oindex] == oindex ) {
+				for ( int n = 0; n < 4; n++ ) {
+					int x = k + dx4[n];
+					int y = j + dy4[n];
+					if ( (x >= 0 && x < width) && (y >= 0 && y < height) ) {
+						int nindex = y*width + x;
+						if ( parent[nindex] < oindex ) adjlabel = seglabel[parent[nindex]];
+					}
+				}
+
+				if ( segsize[oindex] <= SUPSZ >> 2 ) {
+					seglabel[oindex] = adjlabel;
+				} else {
+					seglabel[oindex] = label;
+					label++;
+				}
+			}
+			oindex++;
+		}
+	}
+	numlabels = label;
+
+	for ( int i = 0; i < sz; i++ ) nlabels[i] = seglabel[parent[i]];
+}
+
+//===========================================================================
+///	EnforceSupervoxelLabelConnectivity
+///
+/// Flood fill over the 10-neighbourhood (8 in the frame, 2 across frames),
+/// merging too small supervoxels into an adjacent one.
+//===========================================================================
+void SLIC::EnforceSupervoxelLabelConnectivity(
+	int**						labels,//input labels that need to be corrected to remove stray labels
+	const int&					width,
+	const int&					height,
+	const int&					depth,
+	int&						numlabels,//the number of labels changes in the end if segments are removed
+	const int&					K ) //the number of supervoxels seeded
+{
+	const int sz = width*height;
+	const int SUPSZ = (int)((double)sz * depth / K);
+
+	vector< vector<int> > &nlabels = m_workspace->nvoxellabels;
+	nlabels.resize( depth );
+	for ( int d = 0; d < depth; d++ ) nlabels[d].assign( sz, -1 );
+	vector<int> segment;//voxel indices d*sz + i of the current segment
+
+	int lab( 0 );
+	int adjlabel( 0 );//adjacent label
+	for ( int d = 0; d < depth; d++ ) {
+		for ( int j = 0; j < height; j++ ) {
+			for ( int k = 0; k < width; k++ ) {
+				int oindex = j*width + k;
+				if ( 0 <= nlabels[d][oindex] ) continue;
+
+				nlabels[d][oindex] = lab;
 				//-------------------------------------------------------
 				// Quickly find an adjacent label for use later if needed
 				//-------------------------------------------------------
-				{for ( int n = 0; n < 4; n++ ) {
-					int x = xvec[0] + dx4[n];
-					int y = yvec[0] + dy4[n];
-					if ( (x >= 0 && x < width) && (y >= 0 && y < height) ) {
+				for ( int n = 0; n < 10; n++ ) {
+					int x = k + dx10[n];
+					int y = j + dy10[n];
+					int z = d + dz10[n];
+					if ( (x >= 0 && x < width) && (y >= 0 && y < height) && (z >= 0 && z < depth) ) {
 						int nindex = y*width + x;
-						if ( nlabels[nindex] >= 0 ) adjlabel = nlabels[nindex];
+						if ( nlabels[z][nindex] >= 0 ) adjlabel = nlabels[z][nindex];
 					}
-				}}
-
-				int count( 1 );
-				for ( int c = 0; c < count; c++ ) {
-					for ( int n = 0; n < 4; n++ ) {
-						int x = xvec[c] + dx4[n];
-						int y = yvec[c] + dy4[n];
+				}
 
-						if ( (x >= 0 && x < width) && (y >= 0 && y < height) ) {
+				segment.clear();
+				segment.push_back( d*sz + oindex );
+				for ( size_t c = 0; c < segment.size(); c++ ) {
+					int cz = segment[c] / sz;
+					int cindex = segment[c] % sz;
+					for ( int n = 0; n < 10; n++ ) {
+						int x = cindex % width + dx10[n];
+						int y = cindex / width + dy10[n];
+						int z = cz + dz10[n];
+						if ( (x >= 0 && x < width) && (y >= 0 && y < height) && (z >= 0 && z < depth) ) {
 							int nindex = y*width + x;
-
-							if ( 0 > nlabels[nindex] && labels[oindex] == labels[nindex] ) {
-								xvec[count] = x;
-								yvec[count] = y;
-								nlabels[nindex] = label;
-								count++;
+							if ( 0 > nlabels[z][nindex] && labels[d][oindex] == labels[z][nindex] ) {
+								nlabels[z][nindex] = lab;
+								segment.push_back( z*sz + nindex );
 							}
 						}
-
 					}
 				}
 				//-------------------------------------------------------
 				// If segment size is less then a limit, assign an
 				// adjacent label found before, and decrement label count.
 				//-------------------------------------------------------
-				if ( count <= SUPSZ >> 2 ) {
-					for ( int c = 0; c < count; c++ ) {
-						int ind = yvec[c] * width + xvec[c];
-						nlabels[ind] = adjlabel;
+				if ( (int)segment.size() <= SUPSZ >> 2 ) {
+					for ( size_t c = 0; c < segment.size(); c++ ) {
+						nlabels[segment[c] / sz][segment[c] % sz] = adjlabel;
 					}
-					label--;
+					lab--;
 				}
-				label++;
+				lab++;
 			}
-			oindex++;
 		}
 	}
-	numlabels = label;
+	numlabels = lab;
 
-	if ( xvec ) delete[] xvec;
-	if ( yvec ) delete[] yvec;
+	for ( int d = 0; d < depth; d++ ) {
+		for ( int i = 0; i < sz; i++ ) labels[d][i] = nlabels[d][i];
+	}
 }
 
 //===========================================================================
@@ -850,13 +1568,13 @@ void SLIC::PerformSLICO_ForGivenStepSize(
 	if ( perturbseeds ) DetectLabEdges( m_lvec, m_avec, m_bvec, m_width, m_height, edgemag );
 	GetLABXYSeeds_ForGivenStepSize( kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, STEP, perturbseeds, edgemag );
 
-	PerformSuperpixelSegmentation_VariableSandM( kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, klabels, STEP, 10 );
+	PerformSuperpixelSegmentation_VariableSandM( kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, klabels, STEP, 10, m_shiftThres, m_changeRatio );
 	numlabels = kseedsl.size();
 
-	int* nlabels = new int[sz];
+	m_workspace->nlabels.resize( sz );
+	int* nlabels = &m_workspace->nlabels[0];
 	EnforceLabelConnectivity( klabels, m_width, m_height, nlabels, numlabels, double( sz ) / double( STEP*STEP ) );
 	{for ( int i = 0; i < sz; i++ ) klabels[i] = nlabels[i]; }
-	if ( nlabels ) delete[] nlabels;
 }
 
 //===========================================================================
@@ -892,7 +1610,7 @@ void SLIC::PerformSLICO_ForGivenK(
 		DoRGBtoLABConversion( ubuff, m_lvec, m_avec, m_bvec );
 	} else//RGB
 	{
-		m_lvec = new double[sz]; m_avec = new double[sz]; m_bvec = new double[sz];
+		AllocatePlanes( sz );
 		for ( int i = 0; i < sz; i++ ) {
 			m_lvec[i] = ubuff[i] >> 16 & 0xff;
 			m_avec[i] = ubuff[i] >> 8 & 0xff;
@@ -908,13 +1626,13 @@ void SLIC::PerformSLICO_ForGivenK(
 
 	int STEP = sqrt( double( sz ) / double( K ) ) + 2.0;//adding a small value in the even the STEP size is too small.
 	//PerformSuperpixelSLIC(kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, klabels, STEP, edgemag, m);
-	PerformSuperpixelSegmentation_VariableSandM( kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, klabels, STEP, 10 );
+	PerformSuperpixelSegmentation_VariableSandM( kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, klabels, STEP, 10, m_shiftThres, m_changeRatio );
 	numlabels = kseedsl.size();
 
-	int* nlabels = new int[sz];
+	m_workspace->nlabels.resize( sz );
+	int* nlabels = &m_workspace->nlabels[0];
 	EnforceLabelConnectivity( klabels, m_width, m_height, nlabels, numlabels, K );
 	{for ( int i = 0; i < sz; i++ ) klabels[i] = nlabels[i]; }
-	if ( nlabels ) delete[] nlabels;
 }
 
 void SLIC::PerformSLICO_ForGivenK(
@@ -941,7 +1659,7 @@ void SLIC::PerformSLICO_ForGivenK(
 	for ( int s = 0; s < sz; s++ ) klabels[s] = -1;
 	//--------------------------------------------------
 
-	m_lvec = new double[sz]; m_avec = new double[sz]; m_bvec = new double[sz];
+	AllocatePlanes( sz );
 	for ( int i = 0; i < sz; i++ ) {
 		m_lvec[i] = ubuff[i];
 		m_avec[i] = 0;
@@ -958,13 +1676,95 @@ void SLIC::PerformSLICO_ForGivenK(
 
 	int STEP = sqrt( double( sz ) / double( K ) ) + 2.0;//adding a small value in the even the STEP size is too small.
 	//PerformSuperpixelSLIC(kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, klabels, STEP, edgemag, m);
-	PerformSuperpixelSegmentation_VariableSandM( kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, klabels, STEP, 10 );
+	PerformSuperpixelSegmentation_VariableSandM( kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, klabels, STEP, 10, m_shiftThres, m_changeRatio );
 	numlabels = kseedsl.size();
 
-	int* nlabels = new int[sz];
+	m_workspace->nlabels.resize( sz );
+	int* nlabels = &m_workspace->nlabels[0];
 	EnforceLabelConnectivity( klabels, m_width, m_height, nlabels, numlabels, K );
 	{for ( int i = 0; i < sz; i++ ) klabels[i] = nlabels[i]; }
-	if ( nlabels ) delete[] nlabels;
+}
+
+//===========================================================================
+///	PerformSLICO_ForGivenK
+///
+/// Same as above for a CV_32FC3 CIELAB image, whose channels are split
+/// straight into the float planes without any color conversion.
+//===========================================================================
+void SLIC::PerformSLICO_ForGivenK(
+	const cv::Mat&				labImg,
+	int*						klabels,
+	int*						outlabels,
+	int&						numlabels,
+	const int&					K,//required number of superpixels
+	const double&				/*m*/ )//unused, the superpixel compactness is adaptive
+{
+	vector<double>& kseedsl = m_workspace->seeds.l;
+	vector<double>& kseedsa = m_workspace->seeds.a;
+	vector<double>& kseedsb = m_workspace->seeds.b;
+	vector<double>& kseedsx = m_workspace->seeds.x;
+	vector<double>& kseedsy = m_workspace->seeds.y;
+
+	//--------------------------------------------------
+	m_width = labImg.cols;
+	m_height = labImg.rows;
+	int sz = m_width*m_height;
+	//--------------------------------------------------
+	for ( int s = 0; s < sz; s++ ) klabels[s] = -1;
+	//--------------------------------------------------
+	AllocatePlanes( sz );
+
+	cv::Mat planes[3] = {
+		cv::Mat( m_height, m_width, CV_32FC1, m_lvec ),
+		cv::Mat( m_height, m_width, CV_32FC1, m_avec ),
+		cv::Mat( m_height, m_width, CV_32FC1, m_bvec )
+	};
+	cv::split( labImg, planes );
+	//--------------------------------------------------
+
+	int numitr = 10;
+	double shiftThres = m_shiftThres;
+	if ( m_warmStart ) {
+		kseedsl = m_initSeeds.l;
+		kseedsa = m_initSeeds.a;
+		kseedsb = m_initSeeds.b;
+		kseedsx = m_initSeeds.x;
+		kseedsy = m_initSeeds.y;
+		numitr = m_initIters;
+		shiftThres = m_initShiftThres;
+		m_warmStart = false;
+	} else {
+		bool perturbseeds( true );
+		vector<double>& edgemag = m_workspace->edgemag;
+		if ( perturbseeds ) DetectLabEdges( m_lvec, m_avec, m_bvec, m_width, m_height, edgemag );
+		kseedsl.clear();
+		kseedsa.clear();
+		kseedsb.clear();
+		kseedsx.clear();
+		kseedsy.clear();
+		GetLABXYSeeds_ForGivenK( kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, K, perturbseeds, edgemag );
+	}
+
+	int STEP = sqrt( double( sz ) / double( K ) ) + 2.0;//adding a small value in the even the STEP size is too small.
+	PerformSuperpixelSegmentation_VariableSandM( kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, klabels, STEP, numitr, shiftThres, m_changeRatio );
+	numlabels = kseedsl.size();
+
+	m_seeds.l = kseedsl;
+	m_seeds.a = kseedsa;
+	m_seeds.b = kseedsb;
+	m_seeds.x = kseedsx;
+	m_seeds.y = kseedsy;
+
+	EnforceLabelConnectivity( klabels, m_width, m_height, outlabels, numlabels, K );
+
+	//--------------------------------------------------
+	// The first pixel of every new label lies in the
+	// component whose seed the label is numbered after
+	//--------------------------------------------------
+	m_seedOfLabel.assign( numlabels, -1 );
+	for ( int i = 0; i < sz; i++ ) {
+		if ( m_seedOfLabel[outlabels[i]] < 0 ) m_seedOfLabel[outlabels[i]] = klabels[i];
+	}
 }
 
 void SLIC::GenerateSuperpixels( cv::Mat& img, UINT numSuperpixels ) {
@@ -975,7 +1775,8 @@ void SLIC::GenerateSuperpixels( cv::Mat& img, UINT numSuperpixels ) {
 	int height = img.rows;
 	int width = img.cols;
 	int sz = height * width;
-	label = new int[sz];
+	m_workspace->klabels.resize( sz );
+	label = &m_workspace->klabels[0];
 	if ( img.channels() == 1 ) {
 		type = GRAY;
 	} else if ( img.channels() == 3 ) {
@@ -983,11 +1784,254 @@ void SLIC::GenerateSuperpixels( cv::Mat& img, UINT numSuperpixels ) {
 	}
 	if ( type == GRAY ) {
 		Mat2Buffer( img, bufferGray );
-		PerformSLICO_ForGivenK( bufferGray, img.cols, img.rows, label, sz, numSuperpixels, 10 );
+		PerformSLICO_ForGivenK( bufferGray, img.cols, img.rows, label, m_numlabels, numSuperpixels, 10 );
 	} else if ( type == RGB ) {
 		Mat2Buffer( img, bufferRGB );
-		PerformSLICO_ForGivenK( bufferRGB, img.cols, img.rows, label, sz, numSuperpixels, 10 );
+		PerformSLICO_ForGivenK( bufferRGB, img.cols, img.rows, label, m_numlabels, numSuperpixels, 10 );
+	}
+}
+
+void SLIC::GenerateSuperpixelsFromLab( const cv::Mat& labImg, UINT numSuperpixels ) {
+	if ( labImg.empty() || labImg.type() != CV_32FC3 ) {
+		exit( -1 );
+	}
+
+	int sz = labImg.rows * labImg.cols;
+	m_workspace->klabels.resize( sz );
+	m_workspace->nlabels.resize( sz );
+	label = &m_workspace->nlabels[0];
+	type = LAB;
+	m_labImg = labImg;
+	PerformSLICO_ForGivenK( labImg, &m_workspace->klabels[0], label, m_numlabels, numSuperpixels, 10 );
+}
+
+void SLIC::GenerateSuperpixelsFromLab( const cv::Mat& labImg, UINT numSuperpixels, cv::Mat& labelMat ) {
+	if ( labImg.empty() || labImg.type() != CV_32FC3 ) {
+		exit( -1 );
+	}
+
+	labelMat.create( labImg.rows, labImg.cols, CV_32SC1 );
+	int sz = labImg.rows * labImg.cols;
+
+	//--------------------------------------------------
+	// Proxy scale from the requested superpixel size
+	//--------------------------------------------------
+	double step = sqrt( double( sz ) / double( numSuperpixels ) );
+	if ( m_proxyStep > 0 && m_proxyStep < step ) {
+		int proxywidth = std::max( 1, (int)(labImg.cols * m_proxyStep / step + 0.5) );
+		int proxyheight = std::max( 1, (int)(labImg.rows * m_proxyStep / step + 0.5) );
+		PerformProxySegmentation( labImg, numSuperpixels,
+			double( proxywidth ) / labImg.cols, double( proxyheight ) / labImg.rows, labelMat );
+		return;
+	}
+
+	if ( !labelMat.isContinuous() ) {
+		GenerateSuperpixelsFromLab( labImg, numSuperpixels );
+		cv::Mat( labImg.rows, labImg.cols, CV_32SC1, label ).copyTo( labelMat );
+		return;
+	}
+
+	m_workspace->klabels.resize( sz );
+	label = labelMat.ptr<int>( 0 );
+	type = LAB;
+	m_labImg = labImg;
+	PerformSLICO_ForGivenK( labImg, &m_workspace->klabels[0], label, m_numlabels, numSuperpixels, 10 );
+}
+
+//===========================================================================
+///	PerformProxySegmentation
+///
+/// Clusters a downscaled copy of labImg, maps the seeds back to full
+/// resolution and upsamples the labels by nearest neighbour. Pixels within
+/// half a proxy pixel of a label edge are then reassigned among the labels
+/// around them with the SLICO distance, as in the last clustering iteration.
+//===========================================================================
+void SLIC::PerformProxySegmentation(
+	const cv::Mat&				labImg,
+	UINT						numSuperpixels,
+	double						scalex,
+	double						scaley,
+	cv::Mat&					labelMat ) {
+	int width = labImg.cols;
+	int height = labImg.rows;
+	int sz = width*height;
+	cv::Mat& proxyLab = m_workspace->proxyLab;
+	cv::resize( labImg, proxyLab, cv::Size( (int)(width * scalex + 0.5), (int)(height * scaley + 0.5) ), 0, 0, cv::INTER_AREA );
+	int proxysz = proxyLab.rows * proxyLab.cols;
+
+	//--------------------------------------------------
+	// Warm start seeds are given at full resolution
+	//--------------------------------------------------
+	if ( m_warmStart ) {
+		for ( size_t n = 0; n < m_initSeeds.x.size(); n++ ) {
+			m_initSeeds.x[n] = std::min( std::max( (m_initSeeds.x[n] + 0.5) * scalex - 0.5, 0.0 ), double( proxyLab.cols - 1 ) );
+			m_initSeeds.y[n] = std::min( std::max( (m_initSeeds.y[n] + 0.5) * scaley - 0.5, 0.0 ), double( proxyLab.rows - 1 ) );
+		}
+	}
+
+	//--------------------------------------------------
+	// Shift thresholds and residual in full resolution
+	// pixels too
+	//--------------------------------------------------
+	double scale = 0.5 * (scalex + scaley);
+	double shiftThres = m_shiftThres;
+	m_shiftThres *= scale;
+	m_initShiftThres *= scale;
+
+	m_workspace->proxyklabels.resize( proxysz );
+	m_workspace->proxylabels.resize( proxysz );
+	type = LAB;
+	PerformSLICO_ForGivenK( proxyLab, &m_workspace->proxyklabels[0], &m_workspace->proxylabels[0], m_numlabels, numSuperpixels, 10 );
+
+	m_shiftThres = shiftThres;
+	m_stats.residual /= scale;
+
+	for ( size_t n = 0; n < m_seeds.x.size(); n++ ) {
+		m_seeds.x[n] = (m_seeds.x[n] + 0.5) / scalex - 0.5;
+		m_seeds.y[n] = (m_seeds.y[n] + 0.5) / scaley - 0.5;
+	}
+
+	//--------------------------------------------------
+	// Nearest neighbour upsampling, then refine
+	//--------------------------------------------------
+	m_workspace->nlabels.resize( sz );
+	cv::Mat coarse( height, width, CV_32SC1, &m_workspace->nlabels[0] );
+	cv::resize( cv::Mat( proxyLab.rows, proxyLab.cols, CV_32SC1, &m_workspace->proxylabels[0] ), coarse,
+		coarse.size(), 0, 0, cv::INTER_NEAREST );
+
+	m_width = width;
+	m_height = height;
+	m_labImg = labImg;
+
+	int radius = (int)ceil( 0.5 / std::min( scalex, scaley ) );
+	double step = (sqrt( double( proxysz ) / double( numSuperpixels ) ) + 2.0) / scale;
+	parallel_for_( Range( 0, height ), SlicRefineBody( labImg, &m_workspace->nlabels[0], labelMat, radius,
+		1.0 / (step*step), m_seeds, m_maxlab, m_seedOfLabel ) );
+
+	//--------------------------------------------------
+	// Refinement only moves pixels within the band, but
+	// never let it swallow a whole label
+	//--------------------------------------------------
+	vector<int>& card = m_workspace->segsize;
+	card.assign( m_numlabels, 0 );
+	for ( int y = 0; y < height; y++ ) {
+		const int* row = labelMat.ptr<int>( y );
+		for ( int x = 0; x < width; x++ ) card[row[x]]++;
+	}
+	for ( int y = 0; y < height; y++ ) {
+		int* row = labelMat.ptr<int>( y );
+		const int* coarserow = &m_workspace->nlabels[y*width];
+		for ( int x = 0; x < width; x++ ) {
+			if ( card[coarserow[x]] == 0 ) row[x] = coarserow[x];
+		}
+	}
+
+	if ( labelMat.isContinuous() ) {
+		label = labelMat.ptr<int>( 0 );
+	} else {
+		labelMat.copyTo( coarse );
+		label = &m_workspace->nlabels[0];
+	}
+}
+
+void SLIC::SetProxyStep( int proxyStep ) {
+	m_proxyStep = proxyStep;
+}
+
+void SLIC::SetSimdAssign( bool enable ) {
+	simdAssign = enable;
+}
+
+void SLIC::SetInitialSeeds( const SlicSeeds& seeds, int numIterations, double convergeThres ) {
+	m_warmStart = true;
+	m_initSeeds = seeds;
+	m_initIters = numIterations;
+	m_initShiftThres = convergeThres;
+}
+
+void SLIC::SetConvergence( double shiftThres, double changeRatio ) {
+	m_shiftThres = shiftThres;
+	m_changeRatio = changeRatio;
+}
+
+const SlicStats& SLIC::GetStats() const {
+	return m_stats;
+}
+
+const SlicSeeds& SLIC::GetSeeds() const {
+	return m_seeds;
+}
+
+const std::vector<int>& SLIC::GetSeedOfLabel() const {
+	return m_seedOfLabel;
+}
+
+void SLIC::GenerateSupervoxelsFromLab( const vector<cv::Mat>& labImgs, UINT numSupervoxels, int framesPerSeed ) {
+	if ( labImgs.empty() ) {
+		exit( -1 );
 	}
+
+	m_width = labImgs[0].cols;
+	m_height = labImgs[0].rows;
+	m_depth = labImgs.size();
+	int sz = m_width*m_height;
+	type = LAB;
+
+	AllocateVolume( m_depth, sz );
+	for ( int d = 0; d < m_depth; d++ ) {
+		cv::Mat planes[3] = {
+			cv::Mat( m_height, m_width, CV_32FC1, m_lvecvec[d] ),
+			cv::Mat( m_height, m_width, CV_32FC1, m_avecvec[d] ),
+			cv::Mat( m_height, m_width, CV_32FC1, m_bvecvec[d] )
+		};
+		cv::split( labImgs[d], planes );
+	}
+
+	//--------------------------------------------------
+	// Same hex grid as GetLABXYSeeds_ForGivenK, repeated
+	// every ZSTEP frames
+	//--------------------------------------------------
+	int ZSTEP = std::max( 1, std::min( framesPerSeed, m_depth ) );
+	double step = sqrt( double( sz ) / double( numSupervoxels ) );
+	int xoff = step / 2;
+	int yoff = step / 2;
+
+	vector<double> kseedsl( 0 ), kseedsa( 0 ), kseedsb( 0 );
+	vector<double> kseedsx( 0 ), kseedsy( 0 ), kseedsz( 0 );
+	for ( int z = ZSTEP / 2; z - ZSTEP / 2 < m_depth; z += ZSTEP ) {
+		int Z = std::min( z, m_depth - 1 );
+		int r( 0 );
+		for ( int y = 0; y < m_height; y++ ) {
+			int Y = y*step + yoff;
+			if ( Y > m_height - 1 ) break;
+
+			for ( int x = 0; x < m_width; x++ ) {
+				int X = x*step + (xoff << (r & 0x1));//hex grid
+				if ( X > m_width - 1 ) break;
+
+				int i = Y*m_width + X;
+				kseedsl.push_back( m_lvecvec[Z][i] );
+				kseedsa.push_back( m_avecvec[Z][i] );
+				kseedsb.push_back( m_bvecvec[Z][i] );
+				kseedsx.push_back( X );
+				kseedsy.push_back( Y );
+				kseedsz.push_back( Z );
+			}
+			r++;
+		}
+	}
+
+	int STEP = step + 2.0;
+	PerformSupervoxelSegmentation( kseedsl, kseedsa, kseedsb, kseedsx, kseedsy, kseedsz, &m_supervoxelLabel[0], STEP, ZSTEP, 10 );
+	EnforceSupervoxelLabelConnectivity( &m_supervoxelLabel[0], m_width, m_height, m_depth, m_supervoxelNum, kseedsl.size() );
+}
+
+int** SLIC::GetSupervoxelLabel() {
+	return m_supervoxelLabel.empty() ? NULL : &m_supervoxelLabel[0];
+}
+
+int SLIC::GetSupervoxelNum() {
+	return m_supervoxelNum;
 }
 
 // 
@@ -995,6 +2039,41 @@ int* SLIC::GetLabel() {
 	return label;
 }
 
+int SLIC::GetLabelNum() const {
+	return m_numlabels;
+}
+
+void SLIC::AllocatePlanes( int sz ) {
+	m_workspace->lvec.resize( sz );
+	m_workspace->avec.resize( sz );
+	m_workspace->bvec.resize( sz );
+	m_lvec = &m_workspace->lvec[0];
+	m_avec = &m_workspace->avec[0];
+	m_bvec = &m_workspace->bvec[0];
+}
+
+void SLIC::AllocateVolume( int depth, int sz ) {
+	SlicWorkspace &ws = *m_workspace;
+	ws.lvecvec.resize( depth );
+	ws.avecvec.resize( depth );
+	ws.bvecvec.resize( depth );
+	ws.voxellabels.resize( depth );
+	m_lvecvec.resize( depth );
+	m_avecvec.resize( depth );
+	m_bvecvec.resize( depth );
+	m_supervoxelLabel.resize( depth );
+	for ( int d = 0; d < depth; d++ ) {
+		ws.lvecvec[d].resize( sz );
+		ws.avecvec[d].resize( sz );
+		ws.bvecvec[d].resize( sz );
+		ws.voxellabels[d].assign( sz, -1 );
+		m_lvecvec[d] = &ws.lvecvec[d][0];
+		m_avecvec[d] = &ws.avecvec[d][0];
+		m_bvecvec[d] = &ws.bvecvec[d][0];
+		m_supervoxelLabel[d] = &ws.voxellabels[d][0];
+	}
+}
+
 cv::Mat SLIC::GetImgWithContours( cv::Scalar color ) {
 	if ( type == GRAY ) {
 		DrawContoursAroundSegments( bufferGray, label, m_width, m_height, color );
@@ -1007,6 +2086,17 @@ cv::Mat SLIC::GetImgWithContours( cv::Scalar color ) {
 		memcpy( result.data, bufferRGB, m_width*m_height*sizeof( UINT ) );
 		cvtColor( result, result, CV_BGRA2BGR );
 		return result;
+	} else if ( type == LAB ) {
+		// Only the Lab input is kept, rebuild a BGR buffer for drawing.
+		cv::Mat bgrImg;
+		cv::cvtColor( m_labImg, bgrImg, CV_Lab2BGR );
+		bgrImg.convertTo( bgrImg, CV_8UC3, 255 );
+		Mat2Buffer( bgrImg, bufferRGB );
+		DrawContoursAroundSegments( bufferRGB, label, m_width, m_height, color );
+		cv::Mat result( m_height, m_width, CV_8UC4 );
+		memcpy( result.data, bufferRGB, m_width*m_height*sizeof( UINT ) );
+		cvtColor( result, result, CV_BGRA2BGR );
+		return result;
 	} else {
 		throw std::invalid_argument( "color must be GRAY or RGB" );
 	}
@@ -1015,23 +2105,19 @@ cv::Mat SLIC::GetImgWithContours( cv::Scalar color ) {
 
 void SLIC::Mat2Buffer( const cv::Mat& img, UINT*& buffer ) {
 	int sz = img.cols * img.rows;
-	if ( bufferRGB ) {
-		delete[] bufferRGB;
-	}
-	bufferRGB = new UINT[sz];
+	m_workspace->bufferRGB.resize( sz );
+	bufferRGB = &m_workspace->bufferRGB[0];
 
-	cv::Mat newImage;
+	// Convert straight into the workspace buffer.
+	cv::Mat newImage( img.rows, img.cols, CV_8UC4, bufferRGB );
 	cv::cvtColor( img, newImage, CV_BGR2BGRA );
-	memcpy( bufferRGB, (UINT*)newImage.data, sz*sizeof( UINT ) );
 
 }
 
 void SLIC::Mat2Buffer( const cv::Mat& img, uchar*& buffer ) {
 	int sz = img.cols * img.rows;
-	if ( bufferGray ) {
-		delete[] bufferGray;
-	}
-	bufferGray = new uchar[sz];
+	m_workspace->bufferGray.resize( sz );
+	bufferGray = &m_workspace->bufferGray[0];
 
 	memcpy( bufferGray, (UINT*)img.data, sz*sizeof( uchar ) );
 
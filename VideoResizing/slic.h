@@ -49,11 +49,57 @@
 typedef unsigned int UINT;
 typedef unsigned char uchar;
 
-enum imageType { RGB, GRAY };
+enum imageType { RGB, GRAY, LAB };
+
+// Cluster centers in SLIC's Lab+xy space, one entry per seed
+struct SlicSeeds {
+	std::vector<double> l, a, b, x, y;
+};
+
+// Partial centroid sums and distance maxima over one stripe or frame
+struct SlicPartial {
+	std::vector<double> sigmal, sigmaa, sigmab, sigmax, sigmay;
+	std::vector<double> maxlab, maxxy;
+	std::vector<int> clustersize;
+	int labelchanges;
+};
+
+// Counters of the last clustering run, for tuning iterations against quality
+struct SlicStats {
+	int iterations;
+	double elapsedMs;		// time spent in the clustering iterations
+	double residual;		// mean center displacement of the last iteration, in pixels
+	int labelChanges;		// pixels that switched cluster in the last iteration
+};
+
+//===========================================================================
+///	Image sized buffers SLIC works in. Keep one alive across calls, e.g. for
+/// all keyframes of a shot, and nothing is reallocated unless a frame grows.
+//===========================================================================
+struct SlicWorkspace {
+	std::vector<float>				lvec, avec, bvec;
+	std::vector<float>				distlab, distxy, distvec;
+	std::vector<int>				klabels, nlabels, prevlabels;
+	std::vector<int>				parent, segsize, seglabel;
+	std::vector<UINT>				bufferRGB;
+	std::vector<uchar>				bufferGray;
+	std::vector<SlicPartial>		partials;
+	std::vector< std::vector<int> >	stripeseeds;
+	cv::Mat							proxyLab;
+	std::vector<int>				proxylabels, proxyklabels;
+	std::vector<double>				edgemag;
+	SlicSeeds						seeds; // the seeds being clustered
+	cv::Mat							labelMat; // CV_32SC1 labels for a caller that only reads them once
+	// one entry per frame of a supervoxel stack
+	std::vector< std::vector<float> >	lvecvec, avecvec, bvecvec;
+	std::vector< std::vector<float> >	voxeldistlab, voxeldistxy, voxeldistvec;
+	std::vector< std::vector<int> >		voxellabels, nvoxellabels;
+};
 
 class SLIC_EXPORTS SLIC {
 public:
 	SLIC();
+	SLIC( SlicWorkspace& workspace );
 	virtual ~SLIC();
 
 	//===========================================================================
@@ -64,11 +110,99 @@ public:
 		cv::Mat& img,
 		UINT numSuperpixels );
 
+	//===========================================================================
+	///	Perform SLIC algorithm on an image already converted to CIELAB
+	/// (CV_32FC3, L in [0,100]), skipping the internal color conversion
+	//===========================================================================
+	void GenerateSuperpixelsFromLab(
+		const cv::Mat& labImg,
+		UINT numSuperpixels );
+
+	//===========================================================================
+	///	Same as above, writing the labels straight into labelMat (CV_32SC1,
+	/// the size of labImg) instead of a SLIC owned buffer
+	//===========================================================================
+	void GenerateSuperpixelsFromLab(
+		const cv::Mat& labImg,
+		UINT numSuperpixels,
+		cv::Mat& labelMat );
+
+	//===========================================================================
+	///	Perform SLIC jointly on a stack of CIELAB images (CV_32FC3) giving
+	/// supervoxels, numSupervoxels per frame with seeds placed every
+	/// framesPerSeed frames. Labels are shared across the whole stack.
+	//===========================================================================
+	void GenerateSupervoxelsFromLab(
+		const std::vector<cv::Mat>& labImgs,
+		UINT numSupervoxels,
+		int framesPerSeed );
+
+	//===========================================================================
+	///	Supervoxel labels, one width*height array per frame of the stack
+	//===========================================================================
+	int** GetSupervoxelLabel();
+
+	int GetSupervoxelNum();
+
+	//===========================================================================
+	///	Choose the float SoA SIMD assignment kernel (default) or the original
+	/// double precision loop, which is kept as the reference implementation
+	//===========================================================================
+	void SetSimdAssign( bool enable );
+
+	//===========================================================================
+	///	Start the next GenerateSuperpixelsFromLab from the given seeds instead
+	/// of a fresh grid, running at most numIterations iterations and stopping
+	/// once the mean seed displacement drops below convergeThres pixels
+	//===========================================================================
+	void SetInitialSeeds(
+		const SlicSeeds& seeds,
+		int numIterations,
+		double convergeThres );
+
+	//===========================================================================
+	///	Stop iterating once the mean center displacement is below shiftThres
+	/// pixels and at most changeRatio of the pixels switched cluster. A zero
+	/// threshold is ignored; both zero (the default) runs every iteration
+	//===========================================================================
+	void SetConvergence(
+		double shiftThres,
+		double changeRatio );
+
+	//===========================================================================
+	///	Let the labelMat overload of GenerateSuperpixelsFromLab cluster on a
+	/// proxy downscaled so the grid step is about proxyStep pixels, then
+	/// upsample the labels and refine them near edges at full resolution.
+	/// 0 (the default) always segments at full resolution
+	//===========================================================================
+	void SetProxyStep( int proxyStep );
+
+	//===========================================================================
+	///	Counters of the last segmentation
+	//===========================================================================
+	const SlicStats& GetStats() const;
+
+	//===========================================================================
+	///	Final cluster centers of the last GenerateSuperpixelsFromLab
+	//===========================================================================
+	const SlicSeeds& GetSeeds() const;
+
+	//===========================================================================
+	///	Seed index each output label grew from, so warm started runs can
+	/// match labels across frames
+	//===========================================================================
+	const std::vector<int>& GetSeedOfLabel() const;
+
 	//===========================================================================
 	///	Get label on each pixel which shows the number of superpixel it belongs to
 	//===========================================================================
 	int* GetLabel();
 
+	//===========================================================================
+	///	Number of labels of the last segmentation
+	//===========================================================================
+	int GetLabelNum() const;
+
 	//===========================================================================
 	///	Get the result image with contours on the given color
 	//===========================================================================
@@ -108,6 +242,14 @@ private:
 		const int&					K,//required number of superpixels
 		const double&				m );//weight given to spatial distance
 
+	void PerformSLICO_ForGivenK(
+		const cv::Mat&				labImg,
+		int*						klabels,
+		int*						outlabels,
+		int&						numlabels,
+		const int&					K,//required number of superpixels
+		const double&				m );//weight given to spatial distance
+
 	//============================================================================
 	// Save superpixel labels in a text file in raster scan order
 	//============================================================================
@@ -157,6 +299,23 @@ private:
 		std::vector<double>&				kseedsy,
 		int*						klabels,
 		const int&					STEP,
+		const int&					NUMITR,
+		const double&				shiftThres,
+		const double&				changeRatio );
+	//============================================================================
+	// Supervoxel version of the above on m_lvecvec/m_avecvec/m_bvecvec, with
+	// seed windows ZSTEP frames deep and frames processed in parallel.
+	//============================================================================
+	void PerformSupervoxelSegmentation(
+		std::vector<double>&				kseedsl,
+		std::vector<double>&				kseedsa,
+		std::vector<double>&				kseedsb,
+		std::vector<double>&				kseedsx,
+		std::vector<double>&				kseedsy,
+		std::vector<double>&				kseedsz,
+		int**						klabels,
+		const int&					STEP,
+		const int&					ZSTEP,
 		const int&					NUMITR );
 	//============================================================================
 	// Pick seeds for superpixels when step size of superpixels is given.
@@ -197,9 +356,9 @@ private:
 	// Detect color edges, to help PerturbSeeds()
 	//============================================================================
 	void DetectLabEdges(
-		const double*				lvec,
-		const double*				avec,
-		const double*				bvec,
+		const float*				lvec,
+		const float*				avec,
+		const float*				bvec,
 		const int&					width,
 		const int&					height,
 		std::vector<double>&				edges );
@@ -228,17 +387,17 @@ private:
 	//============================================================================
 	void DoRGBtoLABConversion(
 		const unsigned int*&		ubuff,
-		double*&					lvec,
-		double*&					avec,
-		double*&					bvec );
+		float*&						lvec,
+		float*&						avec,
+		float*&						bvec );
 	//============================================================================
 	// sRGB to CIELAB conversion for 3-D volumes
 	//============================================================================
 	void DoRGBtoLABConversion(
 		const unsigned int**&		ubuff,
-		double**&					lvec,
-		double**&					avec,
-		double**&					bvec );
+		float**&					lvec,
+		float**&					avec,
+		float**&					bvec );
 
 	//============================================================================
 	// Post-processing of SLIC segmentation, to avoid stray labels.
@@ -251,6 +410,37 @@ private:
 		int&						numlabels,//the number of labels changes in the end if segments are removed
 		const int&					K ); //the number of superpixels desired by the user
 
+	//============================================================================
+	// Supervoxel version, over the 10-neighbourhood of each voxel.
+	//============================================================================
+	void EnforceSupervoxelLabelConnectivity(
+		int**						labels,
+		const int&					width,
+		const int&					height,
+		const int&					depth,
+		int&						numlabels,
+		const int&					K );
+
+	//============================================================================
+	// Size the workspace Lab planes for sz pixels and point m_lvec.. at them
+	//============================================================================
+	void AllocatePlanes( int sz );
+
+	//============================================================================
+	// Same for depth frames of a supervoxel stack, labels reset to -1
+	//============================================================================
+	void AllocateVolume( int depth, int sz );
+
+	//============================================================================
+	// Proxy path of GenerateSuperpixelsFromLab, scale given per axis
+	//============================================================================
+	void PerformProxySegmentation(
+		const cv::Mat&				labImg,
+		UINT						numSuperpixels,
+		double						scalex,
+		double						scaley,
+		cv::Mat&					labelMat );
+
 	void Mat2Buffer( const cv::Mat& img, UINT*& buffer );
 
 	void Mat2Buffer( const cv::Mat& img, uchar*& buffer );
@@ -261,19 +451,43 @@ private:
 	int										m_height;
 	int										m_depth;
 
-	double*									m_lvec;
-	double*									m_avec;
-	double*									m_bvec;
+	SlicWorkspace							m_ownWorkspace;
+	SlicWorkspace*							m_workspace; // m_ownWorkspace unless one was passed in
+
+	float*									m_lvec; // planes in m_workspace
+	float*									m_avec;
+	float*									m_bvec;
 
-	double**								m_lvecvec;
-	double**								m_avecvec;
-	double**								m_bvecvec;
+	std::vector<float*>						m_lvecvec; // per frame planes in m_workspace
+	std::vector<float*>						m_avecvec;
+	std::vector<float*>						m_bvecvec;
 
-	UINT*									bufferRGB; // buffer for if RGB image
-	uchar*									bufferGray; // buffer if gray image
+	UINT*									bufferRGB; // buffer for if RGB image, in m_workspace
+	uchar*									bufferGray; // buffer if gray image, in m_workspace
 
-	int*									label; // label record which superpixel a pixel belongs to
+	int*									label; // label record which superpixel a pixel belongs to, not owned
+	int										m_numlabels;
+	std::vector<int*>						m_supervoxelLabel; // per frame labels in volume mode, in m_workspace
+	int										m_supervoxelNum;
 	imageType								type;
+
+	bool									simdAssign; // use AssignWindowRow instead of the double loop
+
+	bool									m_warmStart; // seed from m_initSeeds on the next run
+	SlicSeeds								m_initSeeds;
+	int										m_initIters;
+	double									m_initShiftThres; // replaces m_shiftThres for the warm run
+
+	double									m_shiftThres;
+	double									m_changeRatio;
+	SlicStats								m_stats;
+	std::vector<double>						m_maxlab; // final SLICO color normalizer of every seed
+
+	int										m_proxyStep;
+	cv::Mat									m_labImg; // Lab input of the last run, for drawing
+
+	SlicSeeds								m_seeds; // final cluster centers
+	std::vector<int>						m_seedOfLabel;
 };
 
 #endif
\ No newline at end of file